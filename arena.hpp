@@ -0,0 +1,359 @@
+
+/// @brief Bump-pointer arena that hands out optional_references to the objects it creates.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_ARENA_HPP
+#define DL_ARENA_HPP
+
+#include "optional_reference.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Checked references are the default in debug builds; define DL_ARENA_CHECKS to get them with NDEBUG as well. The
+// macro changes the type of arena_ref, so every translation unit of a program must agree on it (and on NDEBUG).
+#if !defined(DL_ARENA_CHECKS) && !defined(NDEBUG)
+#define DL_ARENA_CHECKS
+#endif
+
+#ifdef DL_ARENA_CHECKS
+#include <cstdio>
+#include <cstdlib>
+#endif
+
+
+namespace dl {
+
+  class arena;
+
+
+#ifdef DL_ARENA_CHECKS
+
+  namespace detail {
+
+    /// @brief Epoch of a checked arena, shared with the references it hands out so that they can outlive it.
+    /// @details alive is cleared by the arena's destructor.
+    struct arena_state {
+      std::uint64_t epoch = 0;
+      bool alive = true;
+    };
+
+  } // namespace detail
+
+
+  /// @brief Reference to an object created by an arena, checked against the arena's epoch on every access.
+  /// @details Dereferencing after the arena has been reset or destroyed prints a diagnostic and aborts. Converting to
+  /// an optional_reference is checked as well, but the resulting optional_reference is not. The members, conversions
+  /// and the prefetch, chain and fetch helpers mirror those of optional_reference, so code that compiles against the
+  /// unchecked build compiles against this one too.
+  template <class T>
+  class arena_ref {
+
+  public:
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr arena_ref() noexcept
+      : m_reference(), m_state(), m_epoch(0) {}
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr arena_ref(nullref_t) noexcept
+      : m_reference(), m_state(), m_epoch(0) {}
+
+    /// Const and derived-to-base conversion.
+    template <class U, std::enable_if_t<std::is_convertible_v<U*, T*> && !std::is_same_v<U, T>, int> = 0>
+    [[nodiscard]] arena_ref(const arena_ref<U>& other) noexcept
+      : m_reference(other.m_reference.ptr()), m_state(other.m_state), m_epoch(other.m_epoch) {}
+
+
+    /// Returns the reference as an optional_reference, to T or to a const-qualified type or base class of T.
+    template <class U, std::enable_if_t<std::is_convertible_v<T*, U*>, int> = 0>
+    [[nodiscard]] operator optional_reference<U>() const noexcept {
+      check();
+      return m_reference.ptr();
+    }
+
+
+    /// Returns true if *this contains a reference, false otherwise.
+    [[nodiscard]] constexpr operator bool() const noexcept {
+      return m_reference.has_ref();
+    }
+
+    /// Returns true if *this contains a reference, false otherwise.
+    [[nodiscard]] constexpr bool has_ref() const noexcept {
+      return m_reference.has_ref();
+    }
+
+    /// @brief Returns the contained reference.
+    /// @details Unlike arena_ref::ref, this operator does not check that *this contains a reference.
+    [[nodiscard]] T& operator*() const noexcept {
+      check();
+      return *m_reference;
+    }
+
+    /// @brief Returns the address of the referenced object.
+    /// @details Unlike arena_ref::ref, this operator does not check that *this contains a reference.
+    [[nodiscard]] T* operator->() const noexcept {
+      check();
+      return m_reference.ptr();
+    }
+
+    /// @brief Returns the contained reference.
+    /// @exception bad_optional_reference_access - If *this is empty.
+    [[nodiscard]] T& ref() const {
+      if (!m_reference) throw bad_optional_reference_access();
+      check();
+      return *m_reference;
+    }
+
+    /// Returns the address of the referenced object, or nullptr if *this is empty.
+    [[nodiscard]] T* ptr() const noexcept {
+      check();
+      return m_reference.ptr();
+    }
+
+    /// @brief Returns a reference to the referenced object as a U, or an empty reference if it is not one.
+    /// @details See optional_reference::as. The result is checked against the same arena epoch as *this.
+    template <class U>
+    [[nodiscard]] arena_ref<U> as() const {
+      check();
+      return arena_ref<U>(m_reference.template as<U>(), m_state, m_epoch);
+    }
+
+
+    /// If *this contains a reference, resets it to being empty.
+    void reset() noexcept {
+      m_reference.reset();
+      m_state.reset();
+    }
+
+  private:
+    friend class arena;
+
+    template <class U>
+    friend class arena_ref;
+
+
+    [[nodiscard]] arena_ref(optional_reference<T> reference, std::shared_ptr<const detail::arena_state> state,
+      std::uint64_t epoch) noexcept
+      : m_reference(reference), m_state(std::move(state)), m_epoch(epoch) {}
+
+    [[nodiscard]] bool current() const noexcept {
+      return m_state && m_state->alive && m_state->epoch == m_epoch;
+    }
+
+    void check() const noexcept {
+      if (m_reference && !current()) {
+        std::fprintf(stderr, "arena reference to %p used after arena::%s\n",
+          static_cast<const volatile void*>(m_reference.ptr()),
+          m_state && !m_state->alive ? "~arena()" : "reset()");
+        std::abort();
+      }
+    }
+
+
+    optional_reference<T> m_reference;
+    std::shared_ptr<const detail::arena_state> m_state;
+    std::uint64_t m_epoch;
+
+  }; // template class arena_ref
+
+
+  /// Hints the processor to start loading the referenced object into the cache. See dl::prefetch.
+  template <class T>
+  inline void prefetch(const arena_ref<T>& reference) noexcept {
+    prefetch(optional_reference<T>(reference));
+  }
+
+#else
+
+  /// Reference to an object created by an arena. Without DL_ARENA_CHECKS this is a plain optional_reference.
+  template <class T>
+  using arena_ref = optional_reference<T>;
+
+#endif
+
+
+  /// @brief Bump-pointer allocator for objects that are all freed together.
+  /// @details Memory comes from blocks of at least block_size bytes, which are kept across reset() and reused, and only
+  /// returned when the arena is destroyed. Objects with non-trivial destructors are recorded in a list stored in the
+  /// arena itself and destroyed, newest first, by reset() and by the destructor.
+  class arena {
+
+  public:
+    static constexpr std::size_t default_block_size = 64 * 1024;
+
+
+    /// Constructs an arena that allocates memory in blocks of at least block_size bytes.
+    [[nodiscard]] explicit arena(std::size_t block_size = default_block_size)
+      : m_first(nullptr), m_current(nullptr), m_cursor(nullptr), m_end(nullptr), m_destructors(nullptr),
+        m_block_size(block_size), m_epoch(0)
+#ifdef DL_ARENA_CHECKS
+        , m_state(std::make_shared<detail::arena_state>())
+#endif
+    {}
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    ~arena() {
+      destroy_objects();
+#ifdef DL_ARENA_CHECKS
+      m_state->alive = false;
+#endif
+      while (m_first) ::operator delete(std::exchange(m_first, m_first->next));
+    }
+
+
+    /// Constructs an object of type T from args in the arena and returns a reference to it.
+    template <class T, class... Args>
+    [[nodiscard]] arena_ref<T> make(Args&&... args) {
+      if constexpr (std::is_trivially_destructible_v<T>) {
+        T* object = ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        return reference(*object);
+      } else {
+        destructor* record = static_cast<destructor*>(allocate(sizeof(destructor), alignof(destructor)));
+        T* object = ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        m_destructors = ::new (record) destructor{ &destroy<T>, object, m_destructors };
+        return reference(*object);
+      }
+    }
+
+    /// Returns size bytes of uninitialized memory aligned to alignment, which must be a power of two.
+    [[nodiscard]] void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+      void* memory = m_cursor;
+      std::size_t space = static_cast<std::size_t>(m_end - m_cursor);
+      if (!m_cursor || !std::align(alignment, size, memory, space)) memory = next_block(size, alignment);
+      m_cursor = static_cast<std::byte*>(memory) + size;
+      return memory;
+    }
+
+
+    /// @brief Destroys every object created since the last reset and makes the memory available again.
+    /// @details Every arena_ref created before the call becomes invalid.
+    void reset() noexcept {
+      destroy_objects();
+      ++m_epoch;
+#ifdef DL_ARENA_CHECKS
+      m_state->epoch = m_epoch;
+#endif
+      m_current = m_first;
+      m_cursor = m_first ? m_first->data() : nullptr;
+      m_end = m_first ? m_first->data() + m_first->size : nullptr;
+    }
+
+    /// Returns the number of times the arena has been reset.
+    [[nodiscard]] std::uint64_t epoch() const noexcept {
+      return m_epoch;
+    }
+
+    /// @brief Returns true if the arena reference has not been invalidated by a reset() or by destroying its arena.
+    /// @details Always returns true without DL_ARENA_CHECKS, where the reference does not record its epoch.
+    template <class T>
+    [[nodiscard]] static bool valid([[maybe_unused]] const arena_ref<T>& reference) noexcept {
+#ifdef DL_ARENA_CHECKS
+      return reference.current();
+#else
+      return true;
+#endif
+    }
+
+  private:
+    struct block {
+      block* next;
+      std::size_t size;
+
+      [[nodiscard]] std::byte* data() noexcept {
+        return reinterpret_cast<std::byte*>(this + 1);
+      }
+    };
+
+    struct destructor {
+      void (*destroy)(void*) noexcept;
+      void* object;
+      destructor* next;
+    };
+
+
+    template <class T>
+    static void destroy(void* object) noexcept {
+      static_cast<T*>(object)->~T();
+    }
+
+    template <class T>
+    [[nodiscard]] arena_ref<T> reference(T& object) const noexcept {
+#ifdef DL_ARENA_CHECKS
+      return arena_ref<T>(object, m_state, m_epoch);
+#else
+      return object;
+#endif
+    }
+
+    void destroy_objects() noexcept {
+      for (destructor* record = m_destructors; record; record = record->next) record->destroy(record->object);
+      m_destructors = nullptr;
+    }
+
+    /// Moves on to the next kept block that can hold the request, or allocates a new one after the current block.
+    [[nodiscard]] void* next_block(std::size_t size, std::size_t alignment) {
+      const std::size_t needed = size + alignment;
+      while (m_current && m_current->next) {
+        m_current = m_current->next;
+        if (m_current->size >= needed) return use(m_current, size, alignment);
+      }
+
+      const std::size_t bytes = std::max(m_block_size, needed);
+      block* fresh = ::new (::operator new(sizeof(block) + bytes)) block{ nullptr, bytes };
+      if (m_current) {
+        fresh->next = std::exchange(m_current->next, fresh);
+      } else {
+        m_first = fresh;
+      }
+      m_current = fresh;
+      return use(fresh, size, alignment);
+    }
+
+    [[nodiscard]] void* use(block* chosen, std::size_t size, std::size_t alignment) noexcept {
+      void* memory = chosen->data();
+      std::size_t space = chosen->size;
+      std::align(alignment, size, memory, space);
+      m_end = chosen->data() + chosen->size;
+      return memory;
+    }
+
+
+    block* m_first;
+    block* m_current;
+    std::byte* m_cursor;
+    std::byte* m_end;
+    destructor* m_destructors;
+    std::size_t m_block_size;
+    std::uint64_t m_epoch;
+#ifdef DL_ARENA_CHECKS
+    std::shared_ptr<detail::arena_state> m_state;
+#endif
+
+  }; // class arena
+
+} // namespace dl
+
+#endif // !DL_ARENA_HPP
@@ -0,0 +1,148 @@
+
+/// @brief Navigation through chains of optional_reference members.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_CHAIN_HPP
+#define DL_CHAIN_HPP
+
+#include "optional_reference.hpp"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  namespace detail::chain {
+
+    /// True for optional_reference and the types that mirror it (such as a checked arena_ref): those with has_ref()
+    /// and a ptr() that returns a pointer.
+    template <class T, class = void>
+    struct is_reference_like : std::false_type {};
+
+    template <class T>
+    struct is_reference_like<T, std::void_t<decltype(std::declval<const T&>().has_ref())>>
+      : std::is_pointer<decltype(std::declval<const T&>().ptr())> {};
+
+    /// Returns the address of the next hop held by a member, which may be an optional_reference, a raw pointer or
+    /// the next object itself.
+    template <class Field>
+    constexpr auto link(Field& field) noexcept {
+      using F = std::remove_cv_t<Field>;
+      if constexpr (is_reference_like<F>::value) {
+        return field.ptr();
+      } else if constexpr (std::is_pointer_v<F>) {
+        return static_cast<F>(field);
+      } else {
+        return std::addressof(field);
+      }
+    }
+
+    /// Returns the address of a root of chain_each, which may be a reference type, a raw pointer or an object.
+    template <class Root>
+    constexpr auto root(Root& root) noexcept {
+      if constexpr (is_reference_like<std::remove_cv_t<Root>>::value) {
+        return root.ptr();
+      } else {
+        return optional_reference(root).ptr();
+      }
+    }
+
+    template <class P, class Member>
+    using next_t = std::remove_pointer_t<decltype(link(std::declval<P*>()->*std::declval<Member>()))>;
+
+    template <class P, class... Members>
+    struct leaf {
+      using type = P;
+    };
+
+    template <class P, class Member, class... Rest>
+    struct leaf<P, Member, Rest...> : leaf<next_t<P, Member>, Rest...> {};
+
+
+    template <class P>
+    constexpr optional_reference<P> walk(P* object) noexcept {
+      return object;
+    }
+
+    template <class P, class Member, class... Rest>
+    constexpr optional_reference<typename leaf<P, Member, Rest...>::type> walk(P* object, Member member,
+      Rest... rest) noexcept {
+      if (!object) return nullref;
+      return walk(link(object->*member), rest...);
+    }
+
+
+    template <std::size_t Group, class P, class OutputIt>
+    constexpr void walk_group(const std::array<P*, Group>& objects, std::size_t count, OutputIt& out) {
+      for (std::size_t i = 0; i < count; ++i) *out++ = optional_reference<P>(objects[i]);
+    }
+
+    /// Advances every chain of the group by one hop, then prefetches all of the new targets before any is read.
+    template <std::size_t Group, class P, class OutputIt, class Member, class... Rest>
+    constexpr void walk_group(const std::array<P*, Group>& objects, std::size_t count, OutputIt& out, Member member,
+      Rest... rest) {
+      std::array<next_t<P, Member>*, Group> next{};
+      for (std::size_t i = 0; i < count; ++i) {
+        next[i] = objects[i] ? link(objects[i]->*member) : nullptr;
+      }
+      for (std::size_t i = 0; i < count; ++i) prefetch(optional_reference(next[i]));
+      walk_group<Group>(next, count, out, rest...);
+    }
+
+  } // namespace detail::chain
+
+
+  /// @brief Follows a chain of members starting at root and returns a reference to the last one.
+  /// @details Each member pointer may name an optional_reference, a raw pointer or a member held by value. The walk
+  /// stops at the first empty link and returns an empty reference, so `dl::chain(order, &order::account,
+  /// &account::owner, &owner::region)` replaces a null check at every level.
+  template <class Root, class... Members,
+    std::enable_if_t<detail::chain::is_reference_like<Root>::value, int> = 0>
+  [[nodiscard]] constexpr auto chain(const Root& root, Members... members) noexcept {
+    return detail::chain::walk(root.ptr(), members...);
+  }
+
+
+  /// @brief Follows the same chain of members from every root in [first, last) and writes the results to out.
+  /// @details Chains are walked Group at a time in lockstep: one hop is taken in every chain of the group and the
+  /// resulting addresses are prefetched before the next hop reads any of them, so that the cache misses of
+  /// independent chains overlap instead of being paid one after another.
+  template <std::size_t Group = 16, class InputIt, class OutputIt, class... Members>
+  OutputIt chain_each(InputIt first, InputIt last, OutputIt out, Members... members) {
+    using root_t = std::remove_pointer_t<decltype(detail::chain::root(*first))>;
+    std::array<root_t*, Group> roots{};
+    while (first != last) {
+      std::size_t count = 0;
+      for (; count < Group && first != last; ++count, ++first) {
+        roots[count] = detail::chain::root(*first);
+        prefetch(optional_reference(roots[count]));
+      }
+      detail::chain::walk_group<Group>(roots, count, out, members...);
+    }
+    return out;
+  }
+
+} // namespace dl
+
+#endif // !DL_CHAIN_HPP
@@ -0,0 +1,204 @@
+
+/// @brief Bloom filter front for lookups that return optional_references.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_FILTERED_LOOKUP_HPP
+#define DL_FILTERED_LOOKUP_HPP
+
+#include "hash_mix.hpp"
+#include "optional_reference.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace dl {
+
+  /// @brief Bloom filter in which all probes for a key land in a single 64-byte block.
+  /// @details Confining a key to one cache line trades a slightly higher false positive rate than a classic Bloom
+  /// filter of the same size for exactly one memory access per query.
+  class blocked_bloom_filter {
+
+  public:
+    /// Constructs an empty filter that can hold no keys.
+    blocked_bloom_filter() noexcept
+      : m_hash_count(1) {}
+
+    /// @brief Constructs an empty filter sized for expected_count keys.
+    /// @details About 10 bits per key give a false positive rate near 1%, and every additional 5 bits per key
+    /// divide it by roughly ten.
+    explicit blocked_bloom_filter(std::size_t expected_count, double bits_per_key = 10.0)
+      : m_blocks(block_count_for(expected_count, bits_per_key)), m_hash_count(optimal_hash_count(bits_per_key)) {}
+
+
+    /// Returns the number of bits to set per key that minimizes the false positive rate.
+    [[nodiscard]] static unsigned optimal_hash_count(double bits_per_key) noexcept {
+      const double k = std::round(bits_per_key * 0.6931471805599453);
+      return k < 1 ? 1u : k > max_hash_count ? max_hash_count : static_cast<unsigned>(k);
+    }
+
+    /// Returns the expected false positive rate of an unblocked filter with the given parameters.
+    [[nodiscard]] static double expected_false_positive_rate(double bits_per_key, unsigned hash_count) noexcept {
+      return std::pow(1.0 - std::exp(-static_cast<double>(hash_count) / bits_per_key), hash_count);
+    }
+
+
+    /// Records the key with the given hash.
+    void insert(std::size_t hash) noexcept {
+      if (m_blocks.empty()) return;
+      block& target = m_blocks[block_index(hash)];
+      for_each_bit(hash, [&target](unsigned bit) {
+        target.words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+      });
+    }
+
+    /// Returns false if the key with the given hash was definitely never inserted.
+    [[nodiscard]] bool may_contain(std::size_t hash) const noexcept {
+      if (m_blocks.empty()) return false;
+      const block& target = m_blocks[block_index(hash)];
+      bool found = true;
+      for_each_bit(hash, [&target, &found](unsigned bit) {
+        found &= (target.words[bit / 64] >> (bit % 64)) & 1;
+      });
+      return found;
+    }
+
+    /// Forgets all inserted keys.
+    void clear() noexcept {
+      for (block& b : m_blocks) b = block();
+    }
+
+
+    /// Returns the size of the filter in bytes.
+    [[nodiscard]] std::size_t size_bytes() const noexcept {
+      return m_blocks.size() * sizeof(block);
+    }
+
+    /// Returns the number of bits set per key.
+    [[nodiscard]] unsigned hash_count() const noexcept {
+      return m_hash_count;
+    }
+
+  private:
+    static constexpr unsigned max_hash_count = 16;
+
+    struct alignas(64) block {
+      std::uint64_t words[8] = {};
+    };
+
+
+    static std::size_t block_count_for(std::size_t expected_count, double bits_per_key) noexcept {
+      const double bits = static_cast<double>(expected_count) * bits_per_key;
+      const std::size_t blocks = static_cast<std::size_t>(std::ceil(bits / (sizeof(block) * 8)));
+      return blocks == 0 ? 1 : blocks;
+    }
+
+    std::size_t block_index(std::size_t hash) const noexcept {
+      // Maps the upper 32 bits of the hash onto the block range without a division.
+      const std::uint64_t upper = detail::mix(hash) >> 32;
+      return static_cast<std::size_t>((upper * m_blocks.size()) >> 32);
+    }
+
+    /// Calls f with the index of each bit of the block that belongs to the key, using double hashing.
+    template <class F>
+    void for_each_bit(std::size_t hash, F&& f) const noexcept {
+      const std::uint64_t mixed = detail::mix(hash);
+      std::uint32_t h1 = static_cast<std::uint32_t>(mixed);
+      const std::uint32_t h2 = static_cast<std::uint32_t>(detail::mix(mixed) >> 32) | 1;
+      for (unsigned i = 0; i < m_hash_count; ++i) {
+        f(h1 >> 23);
+        h1 += h2;
+      }
+    }
+
+
+    std::vector<block> m_blocks;
+    unsigned m_hash_count;
+
+  }; // class blocked_bloom_filter
+
+
+  /// @brief Composes a blocked_bloom_filter with an arbitrary lookup returning an optional_reference.
+  /// @details Every key that the underlying lookup can find must have been passed to insert(). Keys that the filter
+  /// rules out are answered with an empty reference after touching a single cache line, everything else is
+  /// forwarded to the lookup. Erasing keys from the underlying container does not remove them from the filter, which
+  /// stays correct but gradually less selective until rebuilt.
+  template <class Key, class Lookup, class Hash = std::hash<Key>>
+  class filtered_lookup {
+
+  public:
+    /// Wraps lookup, sizing the filter for expected_count keys.
+    filtered_lookup(Lookup lookup, std::size_t expected_count, double bits_per_key = 10.0, Hash hash = Hash())
+      : m_lookup(std::move(lookup)), m_hash(std::move(hash)), m_filter(expected_count, bits_per_key) {}
+
+
+    /// Records a key that the underlying lookup may find.
+    void insert(const Key& key) noexcept {
+      m_filter.insert(m_hash(key));
+    }
+
+    /// Forgets all recorded keys so that the filter can be rebuilt.
+    void clear() noexcept {
+      m_filter.clear();
+    }
+
+
+    /// Returns the result of the underlying lookup, or an empty reference if key is definitely absent.
+    [[nodiscard]] auto find(const Key& key) -> std::invoke_result_t<Lookup&, const Key&> {
+      if (!m_filter.may_contain(m_hash(key))) return nullref;
+      return std::invoke(m_lookup, key);
+    }
+
+    /// Returns the result of the underlying lookup, or an empty reference if key is definitely absent.
+    [[nodiscard]] auto find(const Key& key) const -> std::invoke_result_t<const Lookup&, const Key&> {
+      if (!m_filter.may_contain(m_hash(key))) return nullref;
+      return std::invoke(m_lookup, key);
+    }
+
+
+    /// Returns the underlying lookup.
+    [[nodiscard]] Lookup& lookup() noexcept {
+      return m_lookup;
+    }
+
+    /// Returns the underlying lookup.
+    [[nodiscard]] const Lookup& lookup() const noexcept {
+      return m_lookup;
+    }
+
+    /// Returns the filter.
+    [[nodiscard]] const blocked_bloom_filter& filter() const noexcept {
+      return m_filter;
+    }
+
+  private:
+    Lookup m_lookup;
+    [[no_unique_address]] Hash m_hash;
+    blocked_bloom_filter m_filter;
+
+  }; // template class filtered_lookup
+
+} // namespace dl
+
+#endif // !DL_FILTERED_LOOKUP_HPP
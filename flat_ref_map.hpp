@@ -0,0 +1,575 @@
+
+/// @brief Open-addressing hash map with an optional_reference based lookup API.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_FLAT_REF_MAP_HPP
+#define DL_FLAT_REF_MAP_HPP
+
+#include "hash_mix.hpp"
+#include "optional_reference.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DL_FLAT_REF_MAP_SSE2 1
+#endif
+
+
+namespace dl {
+
+  namespace detail::swiss {
+
+    /// Control byte type. Full slots store the low 7 bits of the hash, special states have the sign bit set.
+    using ctrl_t = std::int8_t;
+
+    inline constexpr ctrl_t ctrl_empty = -128;
+    inline constexpr ctrl_t ctrl_deleted = -2;
+
+
+    /// Iterable set of matching slot offsets within a group.
+    template <class Word, int Shift>
+    class bitmask {
+
+    public:
+      constexpr explicit bitmask(Word mask) noexcept
+        : m_mask(mask) {}
+
+      constexpr explicit operator bool() const noexcept {
+        return m_mask != 0;
+      }
+
+      /// Offset of the lowest matching slot.
+      constexpr std::size_t lowest() const noexcept {
+        return static_cast<std::size_t>(std::countr_zero(m_mask)) >> Shift;
+      }
+
+      constexpr void pop() noexcept {
+        m_mask &= m_mask - 1;
+      }
+
+    private:
+      Word m_mask;
+
+    }; // template class bitmask
+
+
+#ifdef DL_FLAT_REF_MAP_SSE2
+
+    /// Sixteen control bytes matched in parallel with SSE2.
+    class group {
+
+    public:
+      static constexpr std::size_t width = 16;
+
+      explicit group(const ctrl_t* ctrl) noexcept
+        : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+      bitmask<std::uint32_t, 0> match(ctrl_t h2) const noexcept {
+        return bitmask<std::uint32_t, 0>(static_cast<std::uint32_t>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl))));
+      }
+
+      bitmask<std::uint32_t, 0> match_empty() const noexcept {
+        return match(ctrl_empty);
+      }
+
+      bitmask<std::uint32_t, 0> match_empty_or_deleted() const noexcept {
+        return bitmask<std::uint32_t, 0>(static_cast<std::uint32_t>(
+          _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), m_ctrl))));
+      }
+
+    private:
+      __m128i m_ctrl;
+
+    }; // class group
+
+#else
+
+    /// Eight control bytes matched in parallel within a 64-bit word.
+    class group {
+
+    public:
+      static constexpr std::size_t width = 8;
+
+      explicit group(const ctrl_t* ctrl) noexcept
+        : m_ctrl(0) {
+        for (std::size_t i = 0; i < width; ++i) {
+          m_ctrl |= std::uint64_t(static_cast<std::uint8_t>(ctrl[i])) << (8 * i);
+        }
+      }
+
+      /// May report false positives, which are filtered out by the key comparison.
+      bitmask<std::uint64_t, 3> match(ctrl_t h2) const noexcept {
+        const std::uint64_t x = m_ctrl ^ (lsbs * static_cast<std::uint8_t>(h2));
+        return bitmask<std::uint64_t, 3>((x - lsbs) & ~x & msbs);
+      }
+
+      bitmask<std::uint64_t, 3> match_empty() const noexcept {
+        return bitmask<std::uint64_t, 3>(m_ctrl & (~m_ctrl << 6) & msbs);
+      }
+
+      bitmask<std::uint64_t, 3> match_empty_or_deleted() const noexcept {
+        return bitmask<std::uint64_t, 3>(m_ctrl & (~m_ctrl << 7) & msbs);
+      }
+
+    private:
+      static constexpr std::uint64_t lsbs = 0x0101010101010101;
+      static constexpr std::uint64_t msbs = 0x8080808080808080;
+
+      std::uint64_t m_ctrl;
+
+    }; // class group
+
+#endif
+
+  } // namespace detail::swiss
+
+
+  /// @brief Swiss-table style open-addressing hash map whose lookups return optional_references.
+  /// @details Elements are stored inline in a single slot array alongside a byte of hash metadata per slot, which
+  /// is probed a whole group at a time. References returned by the map are invalidated by any insertion that
+  /// causes a rehash, and by erasure of the referenced element.
+  template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+    class Allocator = std::allocator<std::pair<Key, T>>>
+  class flat_ref_map {
+
+  public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+
+    /// Constructs an empty map without allocating.
+    flat_ref_map() noexcept(noexcept(Allocator()))
+      : flat_ref_map(Allocator()) {}
+
+    /// Constructs an empty map that will allocate from the given allocator.
+    explicit flat_ref_map(const Allocator& allocator) noexcept
+      : m_slot_alloc(allocator), m_ctrl_alloc(allocator), m_ctrl(nullptr), m_slots(nullptr), m_capacity(0),
+        m_size(0), m_growth_left(0) {}
+
+    /// Constructs an empty map with room for at least count elements.
+    explicit flat_ref_map(size_type count, const Allocator& allocator = Allocator())
+      : flat_ref_map(allocator) {
+      reserve(count);
+    }
+
+    /// Copy constructor.
+    flat_ref_map(const flat_ref_map& other)
+      : flat_ref_map(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.get_allocator())) {
+      copy_from(other);
+    }
+
+    /// Move constructor.
+    flat_ref_map(flat_ref_map&& other) noexcept
+      : m_hash(std::move(other.m_hash)), m_equal(std::move(other.m_equal)), m_slot_alloc(std::move(other.m_slot_alloc)),
+        m_ctrl_alloc(std::move(other.m_ctrl_alloc)), m_ctrl(std::exchange(other.m_ctrl, nullptr)),
+        m_slots(std::exchange(other.m_slots, nullptr)), m_capacity(std::exchange(other.m_capacity, 0)),
+        m_size(std::exchange(other.m_size, 0)), m_growth_left(std::exchange(other.m_growth_left, 0)) {}
+
+    /// @brief Copy assignment operator.
+    /// @details The allocator of *this is kept, which is what std::pmr allocators expect.
+    flat_ref_map& operator=(const flat_ref_map& other) {
+      if (this != &other) {
+        clear();
+        copy_from(other);
+      }
+      return *this;
+    }
+
+    /// @brief Move assignment operator.
+    /// @details If the allocators compare unequal, elements are moved one by one into memory from this map's allocator.
+    flat_ref_map& operator=(flat_ref_map&& other) noexcept(std::allocator_traits<Allocator>::is_always_equal::value) {
+      if (this == &other) return *this;
+      if (m_slot_alloc == other.m_slot_alloc) {
+        destroy_and_deallocate();
+        m_hash = std::move(other.m_hash);
+        m_equal = std::move(other.m_equal);
+        m_ctrl = std::exchange(other.m_ctrl, nullptr);
+        m_slots = std::exchange(other.m_slots, nullptr);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_size = std::exchange(other.m_size, 0);
+        m_growth_left = std::exchange(other.m_growth_left, 0);
+      } else {
+        clear();
+        reserve(other.m_size);
+        other.for_each_slot([this](value_type& slot) {
+          insert_unique(std::move(slot.first), std::move(slot.second));
+        });
+        other.clear();
+      }
+      return *this;
+    }
+
+    /// Destructor.
+    ~flat_ref_map() {
+      destroy_and_deallocate();
+    }
+
+
+    /// Returns a reference to the value mapped to key, or an empty reference if there is no such element.
+    [[nodiscard]] optional_reference<T> find(const Key& key) noexcept {
+      const std::size_t index = find_index(key);
+      return index != npos ? optional_reference<T>(m_slots[index].second) : nullref;
+    }
+
+    /// Returns a reference to the value mapped to key, or an empty reference if there is no such element.
+    [[nodiscard]] optional_reference<const T> find(const Key& key) const noexcept {
+      const std::size_t index = find_index(key);
+      return index != npos ? optional_reference<const T>(m_slots[index].second) : nullref;
+    }
+
+    /// Returns true if the map contains an element with the given key.
+    [[nodiscard]] bool contains(const Key& key) const noexcept {
+      return find_index(key) != npos;
+    }
+
+
+    /// @brief Inserts a value constructed from args if the key is not present.
+    /// @return The mapped value and whether the insertion took place.
+    template <class K, class... Args>
+    std::pair<T&, bool> try_emplace(K&& key, Args&&... args) {
+      const std::size_t hash = hash_of(key);
+      std::size_t index = find_index(key, hash);
+      if (index != npos) return { m_slots[index].second, false };
+
+      index = prepare_insert(hash);
+      std::allocator_traits<slot_allocator>::construct(m_slot_alloc, m_slots + index, std::piecewise_construct,
+        std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+      set_ctrl(index, h2(hash));
+      ++m_size;
+      return { m_slots[index].second, true };
+    }
+
+    /// Inserts a copy of value if its key is not present.
+    std::pair<T&, bool> insert(const value_type& value) {
+      return try_emplace(value.first, value.second);
+    }
+
+    /// Inserts value if its key is not present.
+    std::pair<T&, bool> insert(value_type&& value) {
+      return try_emplace(std::move(value.first), std::move(value.second));
+    }
+
+    /// Inserts or assigns the value mapped to key.
+    template <class K, class M>
+    std::pair<T&, bool> insert_or_assign(K&& key, M&& value) {
+      auto result = try_emplace(std::forward<K>(key), std::forward<M>(value));
+      if (!result.second) result.first = std::forward<M>(value);
+      return result;
+    }
+
+    /// Returns the value mapped to key, value-initializing it first if it isn't present.
+    T& operator[](const Key& key) {
+      return try_emplace(key).first;
+    }
+
+    /// Returns the value mapped to key, value-initializing it first if it isn't present.
+    T& operator[](Key&& key) {
+      return try_emplace(std::move(key)).first;
+    }
+
+
+    /// Removes the element with the given key. Returns true if an element was removed.
+    bool erase(const Key& key) noexcept {
+      const std::size_t index = find_index(key);
+      if (index == npos) return false;
+
+      std::allocator_traits<slot_allocator>::destroy(m_slot_alloc, m_slots + index);
+      --m_size;
+
+      // A slot can be marked empty instead of deleted if no probe sequence could have passed over it while its
+      // surrounding window was full.
+      const std::size_t before = (index - detail::swiss::group::width) & (m_capacity - 1);
+      const auto empty_after = detail::swiss::group(m_ctrl + index).match_empty();
+      const auto empty_before = detail::swiss::group(m_ctrl + before).match_empty();
+      if (empty_after && empty_before) {
+        const std::size_t leading = leading_full(m_ctrl + before);
+        const std::size_t trailing = empty_after.lowest();
+        if (leading + trailing < detail::swiss::group::width) {
+          set_ctrl(index, detail::swiss::ctrl_empty);
+          ++m_growth_left;
+          return true;
+        }
+      }
+      set_ctrl(index, detail::swiss::ctrl_deleted);
+      return true;
+    }
+
+    /// Destroys all elements while keeping the allocated capacity.
+    void clear() noexcept {
+      if (m_capacity == 0) return;
+      for_each_slot([this](value_type& slot) {
+        std::allocator_traits<slot_allocator>::destroy(m_slot_alloc, std::addressof(slot));
+      });
+      reset_ctrl();
+      m_size = 0;
+    }
+
+    /// Ensures that at least count elements fit without rehashing.
+    void reserve(size_type count) {
+      if (count > m_size + m_growth_left) rehash(capacity_for(count));
+    }
+
+
+    /// @brief Calls f(key, value) for every element.
+    /// @details The iteration order is unspecified.
+    template <class F>
+    void for_each(F&& f) {
+      for_each_slot([&f](value_type& slot) { f(std::as_const(slot.first), slot.second); });
+    }
+
+    /// @brief Calls f(key, value) for every element.
+    /// @details The iteration order is unspecified.
+    template <class F>
+    void for_each(F&& f) const {
+      for_each_slot([&f](const value_type& slot) { f(slot.first, slot.second); });
+    }
+
+
+    /// Returns the number of elements.
+    [[nodiscard]] size_type size() const noexcept {
+      return m_size;
+    }
+
+    /// Returns true if the map contains no elements.
+    [[nodiscard]] bool empty() const noexcept {
+      return m_size == 0;
+    }
+
+    /// Returns the number of slots.
+    [[nodiscard]] size_type capacity() const noexcept {
+      return m_capacity;
+    }
+
+    /// Returns a copy of the allocator.
+    [[nodiscard]] allocator_type get_allocator() const noexcept {
+      return allocator_type(m_slot_alloc);
+    }
+
+  private:
+    using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<value_type>;
+    using ctrl_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<detail::swiss::ctrl_t>;
+    using ctrl_t = detail::swiss::ctrl_t;
+    using group = detail::swiss::group;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+
+    template <class K>
+    std::size_t hash_of(const K& key) const noexcept {
+      return static_cast<std::size_t>(detail::mix(m_hash(key)));
+    }
+
+    static constexpr std::size_t h1(std::size_t hash) noexcept {
+      return hash >> 7;
+    }
+
+    static constexpr ctrl_t h2(std::size_t hash) noexcept {
+      return static_cast<ctrl_t>(hash & 0x7F);
+    }
+
+    static constexpr bool is_full(ctrl_t ctrl) noexcept {
+      return ctrl >= 0;
+    }
+
+    /// Number of consecutive full or deleted slots at the end of the group starting at ctrl.
+    static std::size_t leading_full(const ctrl_t* ctrl) noexcept {
+      std::size_t count = 0;
+      for (std::size_t i = group::width; i-- > 0 && ctrl[i] != detail::swiss::ctrl_empty;) ++count;
+      return count;
+    }
+
+    /// Smallest power-of-two capacity that holds count elements under the maximum load factor of 7/8.
+    static std::size_t capacity_for(std::size_t count) noexcept {
+      const std::size_t minimum = count + (count + 6) / 7;
+      return std::bit_ceil(minimum < group::width ? group::width : minimum);
+    }
+
+    static constexpr std::size_t max_growth(std::size_t capacity) noexcept {
+      return capacity - capacity / 8;
+    }
+
+
+    std::size_t find_index(const Key& key) const noexcept {
+      return find_index(key, hash_of(key));
+    }
+
+    template <class K>
+    std::size_t find_index(const K& key, std::size_t hash) const noexcept {
+      if (m_capacity == 0) return npos;
+      const std::size_t mask = m_capacity - 1;
+      std::size_t offset = h1(hash) & mask;
+      for (std::size_t step = group::width;; step += group::width) {
+        const group g(m_ctrl + offset);
+        for (auto match = g.match(h2(hash)); match; match.pop()) {
+          const std::size_t index = (offset + match.lowest()) & mask;
+          if (m_equal(m_slots[index].first, key)) [[likely]] return index;
+        }
+        if (g.match_empty()) [[likely]] return npos;
+        offset = (offset + step) & mask;
+      }
+    }
+
+    /// Returns the first empty or deleted slot on the probe sequence of hash.
+    std::size_t find_free(std::size_t hash) const noexcept {
+      const std::size_t mask = m_capacity - 1;
+      std::size_t offset = h1(hash) & mask;
+      for (std::size_t step = group::width;; step += group::width) {
+        const auto free = group(m_ctrl + offset).match_empty_or_deleted();
+        if (free) return (offset + free.lowest()) & mask;
+        offset = (offset + step) & mask;
+      }
+    }
+
+    /// Returns a free slot for a new element, growing or compacting the table first if needed.
+    std::size_t prepare_insert(std::size_t hash) {
+      std::size_t index = m_capacity != 0 ? find_free(hash) : npos;
+      if (index == npos || (m_growth_left == 0 && m_ctrl[index] != detail::swiss::ctrl_deleted)) {
+        // Rehash at the same capacity if tombstones make up most of the used slots, otherwise double.
+        if (m_capacity == 0) rehash(group::width);
+        else rehash(m_size * 2 <= max_growth(m_capacity) ? m_capacity : m_capacity * 2);
+        index = find_free(hash);
+      }
+      if (m_ctrl[index] == detail::swiss::ctrl_empty) --m_growth_left;
+      return index;
+    }
+
+    void set_ctrl(std::size_t index, ctrl_t ctrl) noexcept {
+      m_ctrl[index] = ctrl;
+      // The first group is mirrored past the end so that unaligned group loads never wrap.
+      if (index < group::width) m_ctrl[m_capacity + index] = ctrl;
+    }
+
+    void reset_ctrl() noexcept {
+      std::memset(m_ctrl, static_cast<unsigned char>(detail::swiss::ctrl_empty), m_capacity + group::width);
+      m_growth_left = max_growth(m_capacity);
+    }
+
+    template <class F>
+    void for_each_slot(F&& f) {
+      for (std::size_t i = 0; i < m_capacity; ++i) {
+        if (is_full(m_ctrl[i])) f(m_slots[i]);
+      }
+    }
+
+    template <class F>
+    void for_each_slot(F&& f) const {
+      for (std::size_t i = 0; i < m_capacity; ++i) {
+        if (is_full(m_ctrl[i])) f(std::as_const(m_slots[i]));
+      }
+    }
+
+    /// Inserts an element known not to be present, without checking for growth.
+    template <class K, class V>
+    void insert_unique(K&& key, V&& value) {
+      const std::size_t hash = hash_of(key);
+      const std::size_t index = find_free(hash);
+      std::allocator_traits<slot_allocator>::construct(m_slot_alloc, m_slots + index, std::forward<K>(key),
+        std::forward<V>(value));
+      if (m_ctrl[index] == detail::swiss::ctrl_empty) --m_growth_left;
+      set_ctrl(index, h2(hash));
+      ++m_size;
+    }
+
+    void rehash(std::size_t new_capacity) {
+      ctrl_t* const old_ctrl = m_ctrl;
+      value_type* const old_slots = m_slots;
+      const std::size_t old_capacity = m_capacity;
+
+      m_ctrl = std::allocator_traits<ctrl_allocator>::allocate(m_ctrl_alloc, new_capacity + group::width);
+      try {
+        m_slots = std::allocator_traits<slot_allocator>::allocate(m_slot_alloc, new_capacity);
+      } catch (...) {
+        std::allocator_traits<ctrl_allocator>::deallocate(m_ctrl_alloc, m_ctrl, new_capacity + group::width);
+        m_ctrl = old_ctrl;
+        throw;
+      }
+      m_capacity = new_capacity;
+      m_size = 0;
+      reset_ctrl();
+
+      for (std::size_t i = 0; i < old_capacity; ++i) {
+        if (!is_full(old_ctrl[i])) continue;
+        insert_unique(std::move(old_slots[i].first), std::move(old_slots[i].second));
+        std::allocator_traits<slot_allocator>::destroy(m_slot_alloc, old_slots + i);
+      }
+      if (old_capacity != 0) {
+        std::allocator_traits<ctrl_allocator>::deallocate(m_ctrl_alloc, old_ctrl, old_capacity + group::width);
+        std::allocator_traits<slot_allocator>::deallocate(m_slot_alloc, old_slots, old_capacity);
+      }
+    }
+
+    void copy_from(const flat_ref_map& other) {
+      m_hash = other.m_hash;
+      m_equal = other.m_equal;
+      reserve(other.m_size);
+      other.for_each_slot([this](const value_type& slot) {
+        insert_unique(slot.first, slot.second);
+      });
+    }
+
+    void destroy_and_deallocate() noexcept {
+      if (m_capacity == 0) return;
+      clear();
+      std::allocator_traits<ctrl_allocator>::deallocate(m_ctrl_alloc, m_ctrl, m_capacity + group::width);
+      std::allocator_traits<slot_allocator>::deallocate(m_slot_alloc, m_slots, m_capacity);
+      m_ctrl = nullptr;
+      m_slots = nullptr;
+      m_capacity = 0;
+      m_growth_left = 0;
+    }
+
+
+    [[no_unique_address]] Hash m_hash;
+    [[no_unique_address]] KeyEqual m_equal;
+    [[no_unique_address]] slot_allocator m_slot_alloc;
+    [[no_unique_address]] ctrl_allocator m_ctrl_alloc;
+    ctrl_t* m_ctrl;
+    value_type* m_slots;
+    std::size_t m_capacity;
+    std::size_t m_size;
+    std::size_t m_growth_left;
+
+  }; // template class flat_ref_map
+
+
+  namespace pmr {
+
+    /// flat_ref_map using a polymorphic allocator.
+    template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+    using flat_ref_map = dl::flat_ref_map<Key, T, Hash, KeyEqual, std::pmr::polymorphic_allocator<std::pair<Key, T>>>;
+
+  } // namespace pmr
+
+} // namespace dl
+
+#endif // !DL_FLAT_REF_MAP_HPP
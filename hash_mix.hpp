@@ -0,0 +1,44 @@
+
+/// @brief Hash finalizer shared by the hash-based containers.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_HASH_MIX_HPP
+#define DL_HASH_MIX_HPP
+
+#include <cstdint>
+
+
+namespace dl::detail {
+
+  /// @brief Spreads the entropy of a hash over all 64 bits, so that weak hashes such as the identity std::hash for
+  /// integers can be used to pick buckets, fingerprints and seeds.
+  /// @details This is the 64-bit finalizer of MurmurHash3: a bijection in which every input bit affects every output
+  /// bit, cheap enough to run on every lookup.
+  [[nodiscard]] constexpr std::uint64_t mix(std::uint64_t hash) noexcept {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+  }
+
+} // namespace dl::detail
+
+#endif // !DL_HASH_MIX_HPP
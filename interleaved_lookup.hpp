@@ -0,0 +1,280 @@
+
+/// @brief Coroutine-based interleaving of pointer-chasing lookups.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_INTERLEAVED_LOOKUP_HPP
+#define DL_INTERLEAVED_LOOKUP_HPP
+
+#include "optional_reference.hpp"
+
+#include <array>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  namespace detail {
+
+    /// @brief Per-thread recycler for coroutine frames.
+    /// @details Frames are rounded up to a multiple of 64 bytes and carved from 64 KiB chunks that are kept for the
+    /// lifetime of the thread, so once the free lists are warm starting a lookup never reaches the global heap. Frames
+    /// larger than the biggest size class fall back to operator new.
+    class frame_pool {
+
+    public:
+      [[nodiscard]] static void* allocate(std::size_t size) {
+        const std::size_t index = size_class(size);
+        if (index >= class_count) return ::operator new(size);
+
+        pool& p = local();
+        if (free_block* block = p.free[index]) {
+          p.free[index] = block->next;
+          return block;
+        }
+
+        const std::size_t bytes = (index + 1) * granule;
+        if (static_cast<std::size_t>(p.end - p.cursor) < bytes) p.grow();
+        void* block = p.cursor;
+        p.cursor += bytes;
+        return block;
+      }
+
+      static void deallocate(void* pointer, std::size_t size) noexcept {
+        const std::size_t index = size_class(size);
+        if (index >= class_count) return ::operator delete(pointer);
+
+        pool& p = local();
+        p.free[index] = ::new (pointer) free_block{ p.free[index] };
+      }
+
+    private:
+      static constexpr std::size_t granule = 64;
+      static constexpr std::size_t class_count = 16;
+      static constexpr std::size_t chunk_size = 64 * 1024;
+
+      struct free_block {
+        free_block* next;
+      };
+
+      struct pool {
+        std::array<free_block*, class_count> free{};
+        std::byte* cursor = nullptr;
+        std::byte* end = nullptr;
+        free_block* chunks = nullptr;
+
+        pool() = default;
+        pool(const pool&) = delete;
+        pool& operator=(const pool&) = delete;
+
+        ~pool() {
+          while (chunks) ::operator delete(std::exchange(chunks, chunks->next));
+        }
+
+        // The first granule of every chunk links it to the previous one so the destructor can release them all.
+        void grow() {
+          std::byte* chunk = static_cast<std::byte*>(::operator new(chunk_size));
+          chunks = ::new (chunk) free_block{ chunks };
+          cursor = chunk + granule;
+          end = chunk + chunk_size;
+        }
+      };
+
+
+      static constexpr std::size_t size_class(std::size_t size) noexcept {
+        return (size + granule - 1) / granule - 1;
+      }
+
+      static pool& local() noexcept {
+        thread_local pool p;
+        return p;
+      }
+
+    }; // class frame_pool
+
+
+    template <class T>
+    struct fetch_awaitable {
+      optional_reference<T> reference;
+
+      [[nodiscard]] bool await_ready() const noexcept {
+        return !reference;
+      }
+
+      void await_suspend(std::coroutine_handle<>) const noexcept {
+        prefetch(reference);
+      }
+
+      [[nodiscard]] optional_reference<T> await_resume() const noexcept {
+        return reference;
+      }
+    };
+
+  } // namespace detail
+
+
+  /// @brief Prefetches the referenced object and suspends the calling lookup until the scheduler comes back to it.
+  /// @details `node = co_await dl::fetch(node->next);` reads like a plain pointer chase while letting the other lookups
+  /// run during the cache miss. An empty reference is returned immediately without suspending. Besides an
+  /// optional_reference, any type that mirrors it, such as a checked arena_ref, is accepted.
+  template <class Reference, class T = std::remove_pointer_t<decltype(std::declval<const Reference&>().ptr())>>
+  [[nodiscard]] detail::fetch_awaitable<T> fetch(const Reference& reference) noexcept {
+    return detail::fetch_awaitable<T>{ reference.ptr() };
+  }
+
+
+  /// @brief Coroutine type of a lookup run by run_interleaved(), producing a value of type R.
+  /// @details Frames come from a per-thread pool, so a lookup must be destroyed on the thread that created it. An
+  /// exception thrown by the lookup propagates out of the call to resume().
+  template <class R>
+  class lookup_task {
+
+  public:
+    struct promise_type {
+      std::optional<R> result;
+
+      [[nodiscard]] lookup_task get_return_object() noexcept {
+        return lookup_task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+
+      [[nodiscard]] std::suspend_always initial_suspend() const noexcept {
+        return {};
+      }
+
+      [[nodiscard]] std::suspend_always final_suspend() const noexcept {
+        return {};
+      }
+
+      template <class U>
+      void return_value(U&& value) {
+        result.emplace(std::forward<U>(value));
+      }
+
+      void unhandled_exception() {
+        throw;
+      }
+
+      [[nodiscard]] static void* operator new(std::size_t size) {
+        return detail::frame_pool::allocate(size);
+      }
+
+      static void operator delete(void* pointer, std::size_t size) noexcept {
+        detail::frame_pool::deallocate(pointer, size);
+      }
+    };
+
+
+    /// Constructs an object that does not own a lookup.
+    [[nodiscard]] constexpr lookup_task() noexcept
+      : m_handle() {}
+
+    [[nodiscard]] lookup_task(lookup_task&& other) noexcept
+      : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+    lookup_task& operator=(lookup_task&& other) noexcept {
+      if (this != &other) {
+        if (m_handle) m_handle.destroy();
+        m_handle = std::exchange(other.m_handle, nullptr);
+      }
+      return *this;
+    }
+
+    ~lookup_task() {
+      if (m_handle) m_handle.destroy();
+    }
+
+
+    /// Returns true if the lookup has produced its result.
+    [[nodiscard]] bool done() const noexcept {
+      return m_handle.done();
+    }
+
+    /// Runs the lookup until it next suspends or finishes.
+    void resume() const {
+      assert(m_handle && !m_handle.done());
+      m_handle.resume();
+    }
+
+    /// Moves the result out of a finished lookup.
+    [[nodiscard]] R take() const {
+      assert(m_handle && m_handle.done());
+      return std::move(*m_handle.promise().result);
+    }
+
+  private:
+    [[nodiscard]] explicit lookup_task(std::coroutine_handle<promise_type> handle) noexcept
+      : m_handle(handle) {}
+
+
+    std::coroutine_handle<promise_type> m_handle;
+
+  }; // template class lookup_task
+
+
+  /// @brief Runs lookup(*it) for every element of [first, last) on the calling thread with up to N lookups in flight.
+  /// @details lookup must return a lookup_task<R>. The lookups are resumed round-robin, each running until its next
+  /// co_await dl::fetch(), and done(position, result) is called as each one finishes, where position is the index of
+  /// its element in the input. Results therefore arrive out of order.
+  template <std::size_t N = 16, class InputIt, class Lookup, class Done>
+  void run_interleaved(InputIt first, InputIt last, Lookup lookup, Done done) {
+    static_assert(N > 0, "run_interleaved needs at least one lookup in flight");
+    using task = std::invoke_result_t<Lookup&, std::iter_reference_t<InputIt>>;
+
+    std::array<task, N> tasks;
+    std::array<std::size_t, N> positions{};
+    std::size_t position = 0;
+
+    auto start = [&](std::size_t slot) {
+      if (first == last) return false;
+      tasks[slot] = lookup(*first);
+      positions[slot] = position;
+      ++first;
+      ++position;
+      return true;
+    };
+
+    std::size_t active = 0;
+    while (active < N && start(active)) ++active;
+
+    while (active > 0) {
+      for (std::size_t i = 0; i < active;) {
+        tasks[i].resume();
+        if (tasks[i].done()) {
+          done(positions[i], tasks[i].take());
+          if (!start(i)) {
+            --active;
+            tasks[i] = std::move(tasks[active]);
+            positions[i] = positions[active];
+            continue;
+          }
+        }
+        ++i;
+      }
+    }
+  }
+
+} // namespace dl
+
+#endif // !DL_INTERLEAVED_LOOKUP_HPP
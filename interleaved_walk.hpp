@@ -0,0 +1,94 @@
+
+/// @brief Interleaved traversal of many independent optional_reference chains.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_INTERLEAVED_WALK_HPP
+#define DL_INTERLEAVED_WALK_HPP
+
+#include "optional_reference.hpp"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  /// @brief Walks the chain starting at every root in [first, last), keeping up to K chains in flight at once.
+  /// @details step(chain, node) is called for every node reached, where chain is the position of the root in the
+  /// input range, and returns the next node of that chain or an empty reference once the chain is done. The K cursors
+  /// are advanced round-robin and every new cursor is prefetched as soon as it is known, so by the time a cursor is
+  /// dereferenced again the other K - 1 steps have hidden most of its cache miss. A finished cursor is refilled from
+  /// the input right away, so long and short chains can be mixed freely.
+  template <std::size_t K = 16, class InputIt, class Step>
+  void interleaved_walk(InputIt first, InputIt last, Step step) {
+    static_assert(K > 0, "interleaved_walk needs at least one cursor");
+    using node = std::remove_pointer_t<decltype(std::declval<std::iter_reference_t<InputIt>>().ptr())>;
+    static_assert(std::is_convertible_v<std::invoke_result_t<Step&, std::size_t, node&>, optional_reference<node>>,
+      "step must return the next node as an optional_reference");
+
+    struct cursor {
+      node* current;
+      std::size_t chain;
+    };
+
+    std::array<cursor, K> cursors{};
+    std::size_t chain = 0;
+
+    // Takes the next non-empty root from the input, prefetching it. Returns false once the input is exhausted.
+    auto refill = [&](cursor& c) {
+      for (; first != last; ++first, ++chain) {
+        optional_reference<node> root = *first;
+        if (root) {
+          prefetch(root);
+          c = cursor{ root.ptr(), chain };
+          ++first;
+          ++chain;
+          return true;
+        }
+      }
+      c.current = nullptr;
+      return false;
+    };
+
+    std::size_t active = 0;
+    while (active < K && refill(cursors[active])) ++active;
+
+    while (active > 0) {
+      for (std::size_t i = 0; i < active;) {
+        cursor& c = cursors[i];
+        optional_reference<node> next = step(c.chain, *c.current);
+        if (next) {
+          prefetch(next);
+          c.current = next.ptr();
+        } else if (!refill(c)) {
+          // Keep the live cursors packed at the front so the round-robin loop never visits a finished one.
+          c = cursors[--active];
+          continue;
+        }
+        ++i;
+      }
+    }
+  }
+
+} // namespace dl
+
+#endif // !DL_INTERLEAVED_WALK_HPP
@@ -0,0 +1,150 @@
+
+/// @brief Optional reference that holds an id until first use and resolves it in place.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_LAZY_OPTIONAL_REFERENCE_HPP
+#define DL_LAZY_OPTIONAL_REFERENCE_HPP
+
+#include "optional_reference.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+
+namespace dl {
+
+  /// @brief Pointer-sized optional reference that starts out as an id and is resolved on first access.
+  /// @details The single word holds either a pointer or, with its lowest bit set, an id shifted left by one, which is
+  /// why T must be at least 2-byte aligned and ids are limited to one bit less than a pointer. The first access calls
+  /// Resolver{}(id), which must return an optional_reference<T> or a T*, and caches the result with a CAS. Threads that
+  /// race on the first access may each call the resolver, so it must return the same object for the same id, but they
+  /// all end up using the one result that was stored.
+  template <class T, class Resolver>
+  class lazy_optional_reference {
+
+    static_assert(std::is_empty_v<Resolver> && std::is_default_constructible_v<Resolver>,
+      "Resolver must be a stateless function object");
+    static_assert(alignof(T) >= 2, "the lowest bit of T's address is used as the unresolved tag");
+
+  public:
+    using id_type = std::uintptr_t;
+
+    /// The largest id that can be stored.
+    static constexpr id_type max_id = ~id_type(0) >> 1;
+
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr lazy_optional_reference() noexcept
+      : m_word(0) {}
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr lazy_optional_reference(nullref_t) noexcept
+      : m_word(0) {}
+
+    /// Constructs an object holding an id that is resolved on first access.
+    [[nodiscard]] explicit constexpr lazy_optional_reference(id_type id) noexcept
+      : m_word((id << 1) | unresolved) {
+      assert(id <= max_id);
+    }
+
+    /// Constructs an object that already contains a reference.
+    [[nodiscard]] lazy_optional_reference(T& reference) noexcept
+      : m_word(reinterpret_cast<std::uintptr_t>(std::addressof(reference))) {}
+
+    [[nodiscard]] lazy_optional_reference(const lazy_optional_reference& other) noexcept
+      : m_word(other.m_word.load(std::memory_order_acquire)) {}
+
+    lazy_optional_reference& operator=(const lazy_optional_reference& other) noexcept {
+      m_word.store(other.m_word.load(std::memory_order_acquire), std::memory_order_release);
+      return *this;
+    }
+
+
+    /// Resolves the id if needed and returns the resulting reference.
+    [[nodiscard]] optional_reference<T> get() const {
+      std::uintptr_t word = m_word.load(std::memory_order_acquire);
+      if (word & unresolved) word = resolve(word);
+      return reinterpret_cast<T*>(word);
+    }
+
+    /// Returns true if the id has been resolved, or *this never held one.
+    [[nodiscard]] bool resolved() const noexcept {
+      return !(m_word.load(std::memory_order_acquire) & unresolved);
+    }
+
+
+    /// Resolves the id if needed and returns true if *this contains a reference.
+    [[nodiscard]] operator bool() const {
+      return get().has_ref();
+    }
+
+    /// Resolves the id if needed and returns true if *this contains a reference.
+    [[nodiscard]] bool has_ref() const {
+      return get().has_ref();
+    }
+
+
+    /// @brief Resolves the id if needed and returns the contained reference.
+    /// @details Unlike lazy_optional_reference::ref, this operator does not check for an empty result.
+    [[nodiscard]] T& operator*() const {
+      return *get();
+    }
+
+    /// @brief Resolves the id if needed and returns the address of the referenced object.
+    /// @details Unlike lazy_optional_reference::ref, this operator does not check for an empty result.
+    [[nodiscard]] T* operator->() const {
+      return get().ptr();
+    }
+
+    /// @brief Resolves the id if needed and returns the contained reference.
+    /// @exception bad_optional_reference_access - If the result is empty.
+    [[nodiscard]] T& ref() const {
+      return get().ref();
+    }
+
+
+    /// Makes *this empty.
+    void reset() noexcept {
+      m_word.store(0, std::memory_order_release);
+    }
+
+  private:
+    static constexpr std::uintptr_t unresolved = 1;
+
+
+    std::uintptr_t resolve(std::uintptr_t word) const {
+      const optional_reference<T> target = Resolver{}(static_cast<id_type>(word >> 1));
+      const std::uintptr_t resolved = reinterpret_cast<std::uintptr_t>(target.ptr());
+      assert(!(resolved & unresolved));
+      // On failure word receives whatever another thread stored first, which every caller then agrees on.
+      return m_word.compare_exchange_strong(word, resolved, std::memory_order_acq_rel, std::memory_order_acquire)
+        ? resolved : word;
+    }
+
+
+    mutable std::atomic<std::uintptr_t> m_word;
+
+  }; // template class lazy_optional_reference
+
+} // namespace dl
+
+#endif // !DL_LAZY_OPTIONAL_REFERENCE_HPP
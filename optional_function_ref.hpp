@@ -0,0 +1,146 @@
+
+/// @brief Non-owning nullable reference to a callable.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_OPTIONAL_FUNCTION_REF_HPP
+#define DL_OPTIONAL_FUNCTION_REF_HPP
+
+#include "optional_reference.hpp"
+
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  template <class Signature>
+  class optional_function_ref;
+
+
+  /// @brief Two-word non-owning reference to a callable, with optional_reference-like empty semantics.
+  /// @details Stores the address of the callable (or the function pointer itself) and a pointer to a thunk that
+  /// invokes it, so a call costs one indirect call and never allocates. Like any reference, the callable must outlive
+  /// every call made through it, which makes the type best suited to function parameters.
+  template <class R, class... Args>
+  class optional_function_ref<R(Args...)> {
+
+  public:
+    /// Constructs an object that does not refer to a callable.
+    [[nodiscard]] constexpr optional_function_ref() noexcept
+      : m_object(), m_thunk(nullptr) {}
+
+    /// Constructs an object that does not refer to a callable.
+    [[nodiscard]] constexpr optional_function_ref(nullref_t) noexcept
+      : m_object(), m_thunk(nullptr) {}
+
+    /// Constructs an object referring to a function. A null function pointer produces an empty object.
+    template <class F>
+      requires std::is_function_v<F> && std::is_invocable_r_v<R, F&, Args...>
+    [[nodiscard]] optional_function_ref(F* function) noexcept
+      : m_object(), m_thunk(function ? &call_function<F> : nullptr) {
+      m_object.function = reinterpret_cast<void (*)()>(function);
+    }
+
+    /// Constructs an object referring to a callable object.
+    template <class F>
+      requires (!std::is_same_v<std::remove_cvref_t<F>, optional_function_ref>)
+        && (!std::is_same_v<std::remove_cvref_t<F>, nullref_t>)
+        && (!std::is_pointer_v<std::remove_cvref_t<F>>)
+        && std::is_invocable_r_v<R, std::remove_reference_t<F>&, Args...>
+    [[nodiscard]] constexpr optional_function_ref(F&& callable) noexcept
+      : m_object(), m_thunk(&call_object<std::remove_reference_t<F>>) {
+      m_object.object = const_cast<void*>(static_cast<const void*>(std::addressof(callable)));
+    }
+
+
+    /// Returns true if *this refers to a callable, false otherwise.
+    [[nodiscard]] constexpr operator bool() const noexcept {
+      return m_thunk;
+    }
+
+    /// Returns true if *this refers to a callable, false otherwise.
+    [[nodiscard]] constexpr bool has_ref() const noexcept {
+      return m_thunk;
+    }
+
+
+    /// @brief Invokes the referenced callable.
+    /// @details Unlike optional_function_ref::call, this operator is unchecked.
+    R operator()(Args... args) const {
+      assert(m_thunk);
+      return m_thunk(m_object, std::forward<Args>(args)...);
+    }
+
+    /// @brief Invokes the referenced callable.
+    /// @exception bad_optional_reference_access - If *this is empty.
+    R call(Args... args) const {
+      if (!m_thunk) throw bad_optional_reference_access();
+      return m_thunk(m_object, std::forward<Args>(args)...);
+    }
+
+
+    /// If *this refers to a callable, resets it to being empty.
+    constexpr void reset() noexcept {
+      m_thunk = nullptr;
+    }
+
+  private:
+    union storage {
+      void* object;
+      void (*function)();
+    };
+
+    using thunk = R (*)(storage, Args...);
+
+
+    template <class F>
+    static R invoke(F& callable, Args&&... args) {
+      if constexpr (std::is_void_v<R>) {
+        std::invoke(callable, std::forward<Args>(args)...);
+      } else {
+        return std::invoke(callable, std::forward<Args>(args)...);
+      }
+    }
+
+    template <class F>
+    static R call_object(storage object, Args... args) {
+      return invoke(*static_cast<F*>(object.object), std::forward<Args>(args)...);
+    }
+
+    template <class F>
+    static R call_function(storage object, Args... args) {
+      return invoke(*reinterpret_cast<F*>(object.function), std::forward<Args>(args)...);
+    }
+
+
+    storage m_object;
+    thunk m_thunk;
+
+  }; // template class optional_function_ref
+
+
+  template <class R, class... Args>
+  optional_function_ref(R (*)(Args...)) -> optional_function_ref<R(Args...)>;
+
+} // namespace dl
+
+#endif // !DL_OPTIONAL_FUNCTION_REF_HPP
@@ -22,9 +22,75 @@
 #define DL_OPTIONAL_REFERENCE_HPP
 
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 
+#ifdef DL_OPTIONAL_REFERENCE_INSTRUMENT
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#endif
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#if defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DL_OPTIONAL_REFERENCE_USDT 1
+#endif
+#endif
+
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+#endif
+
+#if defined(DL_OPTIONAL_REFERENCE_INSTRUMENT) || defined(DL_OPTIONAL_REFERENCE_TRACE)
+#include <source_location>
+#define DL_OPTIONAL_REFERENCE_CALL_SITE 1
+#endif
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+#include <cstdio>
+#include <source_location>
+#endif
+
+#include <type_traits>
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+/// Marks a class as trivially relocatable for compilers implementing P1144.
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(trivially_relocatable)
+#define DL_TRIVIALLY_RELOCATABLE [[trivially_relocatable]]
+#endif
+#endif
+#ifndef DL_TRIVIALLY_RELOCATABLE
+#define DL_TRIVIALLY_RELOCATABLE
+#endif
+
+#if defined(__has_include) && __has_include(<span>) && __cplusplus >= 202002L
+#include <span>
+#endif
+
+#if defined(DL_OPTIONAL_REFERENCE_TRACE) || defined(DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS)
+#include <array>
+#include <string_view>
+#include <utility>
+#define DL_OPTIONAL_REFERENCE_TYPE_NAME 1
+#endif
+
 
 namespace dl {
 
@@ -39,22 +105,560 @@ namespace dl {
   class bad_optional_reference_access : public std::exception {
 
   public:
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+    /// @brief Constructor.
+    /// @details Fires the exception_constructed probe with the call site that failed, which defaults to the site of
+    /// the throw, and the name of the referenced type, if known.
+    bad_optional_reference_access(std::source_location site = std::source_location::current()) noexcept {
+      probe("", site);
+    }
+
+    /// Constructor recording the name of the referenced type and the call site that failed.
+    explicit bad_optional_reference_access(const char* type,
+      std::source_location site = std::source_location::current()) noexcept {
+      probe(type, site);
+    }
+#else
     /// Constructor.
     bad_optional_reference_access() noexcept {}
+#endif
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+    /// Constructs an exception whose explanation names where the empty reference was created.
+    explicit bad_optional_reference_access(const std::source_location& origin, const char* type = "",
+      std::source_location site = std::source_location::current()) noexcept {
+      describe(origin);
+      probe(type, site);
+    }
+#else
+    /// Constructs an exception whose explanation names where the empty reference was created.
+    explicit bad_optional_reference_access(const std::source_location& origin) noexcept {
+      describe(origin);
+    }
+#endif
 
+    /// Brief explanation of the error.
+    const char* what() const noexcept {
+      return m_message;
+    }
+
+  private:
+    void describe(const std::source_location& origin) noexcept {
+      std::snprintf(m_message, sizeof(m_message), "bad optional reference access (empty reference created at %s:%u in %s)",
+        origin.file_name(), static_cast<unsigned>(origin.line()), origin.function_name());
+    }
+
+    char m_message[512] = "bad optional reference access";
+#else
     /// Brief explanation of the error.
     const char* what() const noexcept {
       return "bad optional reference access";
     }
+#endif
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+  private:
+    void probe([[maybe_unused]] const char* type, [[maybe_unused]] const std::source_location& site) const noexcept {
+#ifdef DL_OPTIONAL_REFERENCE_USDT
+      DTRACE_PROBE5(dl_optional_reference, exception_constructed, what(), site.file_name(), site.line(),
+        site.function_name(), type);
+#endif
+    }
+#endif
 
   }; // class bad_optional_reference_access
 
 
+#ifdef DL_OPTIONAL_REFERENCE_TYPE_NAME
+
+  namespace detail {
+
+    template <class T>
+    constexpr const char* signature() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+      return __FUNCSIG__;
+#else
+      return __PRETTY_FUNCTION__;
+#endif
+    }
+
+    template <class T>
+    constexpr std::string_view type_name_view() noexcept {
+      const std::string_view sig = signature<T>();
+#if defined(_MSC_VER) && !defined(__clang__)
+      const std::size_t first = sig.find("signature<") + 10;
+      return sig.substr(first, sig.rfind(">(void)") - first);
+#else
+      const std::size_t first = sig.find("T = ") + 4;
+      return sig.substr(first, sig.rfind(']') - first);
+#endif
+    }
+
+    template <class T, std::size_t... I>
+    constexpr std::array<char, sizeof...(I) + 1> type_name_array(std::index_sequence<I...>) noexcept {
+      return { type_name_view<T>()[I]..., '\0' };
+    }
+
+    /// Null-terminated name of T, extracted from the compiler's function signature at compile time.
+    template <class T>
+    inline constexpr auto type_name = type_name_array<T>(std::make_index_sequence<type_name_view<T>().size()>());
+
+  } // namespace detail
+
+#endif
+
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+
+  /// @brief Failed optional_reference::ref call recorded by the tracer.
+  /// @details Only available when DL_OPTIONAL_REFERENCE_TRACE is defined. In that build, every empty ref() call is
+  /// recorded in a small ring buffer before throwing. If <sys/sdt.h> is available, it also fires the USDT probe
+  /// dl_optional_reference:bad_access(file, line, function, type), and the exception constructor fires
+  /// dl_optional_reference:exception_constructed(what, file, line, function, type). USDT probes are a single nop until a tracer attaches.
+  struct optional_reference_trace_event {
+    const char* file;
+    const char* function;
+    unsigned line;
+    const char* type;
+  };
+
+  namespace detail::trace {
+
+    /// Fixed-size buffer of the most recent events. Each slot carries the ticket of its last write.
+    struct ring {
+      static constexpr std::size_t capacity = 256;
+
+      struct slot {
+        std::atomic<std::uint64_t> ticket{ 0 };
+        std::atomic<const char*> file{ nullptr };
+        std::atomic<const char*> function{ nullptr };
+        std::atomic<unsigned> line{ 0 };
+        std::atomic<const char*> type{ nullptr };
+      };
+
+      std::atomic<std::uint64_t> next{ 0 };
+      slot slots[capacity];
+    };
+
+    inline ring events;
+
+    [[gnu::cold]] inline void bad_access(const std::source_location& site, const char* type) noexcept {
+#ifdef DL_OPTIONAL_REFERENCE_USDT
+      DTRACE_PROBE4(dl_optional_reference, bad_access, site.file_name(), site.line(), site.function_name(), type);
+#endif
+      const std::uint64_t ticket = events.next.fetch_add(1, std::memory_order_relaxed);
+      ring::slot& slot = events.slots[ticket % ring::capacity];
+      slot.ticket.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.file.store(site.file_name(), std::memory_order_relaxed);
+      slot.function.store(site.function_name(), std::memory_order_relaxed);
+      slot.line.store(site.line(), std::memory_order_relaxed);
+      slot.type.store(type, std::memory_order_relaxed);
+      slot.ticket.store(ticket + 1, std::memory_order_release);
+    }
+
+  } // namespace detail::trace
+
+
+  /// Returns the most recent failed ref() calls, oldest first. Events being written concurrently are skipped.
+  inline std::vector<optional_reference_trace_event> optional_reference_trace_events() {
+    using detail::trace::ring;
+    std::vector<optional_reference_trace_event> result;
+    const std::uint64_t end = detail::trace::events.next.load(std::memory_order_acquire);
+    const std::uint64_t begin = end > ring::capacity ? end - ring::capacity : 0;
+    for (std::uint64_t ticket = begin; ticket < end; ++ticket) {
+      const ring::slot& slot = detail::trace::events.slots[ticket % ring::capacity];
+      if (slot.ticket.load(std::memory_order_acquire) != ticket + 1) continue;
+      const optional_reference_trace_event event{ slot.file.load(std::memory_order_relaxed),
+        slot.function.load(std::memory_order_relaxed), slot.line.load(std::memory_order_relaxed),
+        slot.type.load(std::memory_order_relaxed) };
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.ticket.load(std::memory_order_relaxed) == ticket + 1) result.push_back(event);
+    }
+    return result;
+  }
+
+#endif
+
+
+#ifdef DL_OPTIONAL_REFERENCE_INSTRUMENT
+
+  /// @brief Per-call-site statistics of optional_reference::ref and optional_reference::has_ref.
+  /// @details Only available when DL_OPTIONAL_REFERENCE_INSTRUMENT is defined. In that build, ref() and has_ref()
+  /// take a defaulted std::source_location argument and count how often each call site sees an empty reference.
+  /// Conversion to bool and the dereference operators cannot take an argument and are not counted.
+  struct optional_reference_site_stats {
+    const char* file;
+    const char* function;
+    unsigned line;
+    unsigned column;
+    unsigned long long hits;
+    unsigned long long empties;
+  };
+
+  namespace detail::instrument {
+
+    /// Open-addressing table of call sites written only by the thread that owns it.
+    struct site_table {
+      static constexpr std::size_t capacity = 4096;
+
+      struct entry {
+        std::atomic<const char*> file{ nullptr };
+        const char* function = nullptr;
+        unsigned line = 0;
+        unsigned column = 0;
+        std::atomic<unsigned long long> hits{ 0 };
+        std::atomic<unsigned long long> empties{ 0 };
+      };
+
+      entry entries[capacity];
+      std::atomic<unsigned long long> dropped{ 0 };
+      site_table* next = nullptr;
+    };
+
+    /// Head of the list of all tables ever created. Tables are never freed so that they outlive their threads.
+    inline std::atomic<site_table*> tables{ nullptr };
+
+    inline site_table& local_table() {
+      thread_local site_table* const table = [] {
+        site_table* created = new site_table();
+        created->next = tables.load(std::memory_order_relaxed);
+        while (!tables.compare_exchange_weak(created->next, created, std::memory_order_release,
+          std::memory_order_relaxed)) {}
+        return created;
+      }();
+      return *table;
+    }
+
+    /// Only the owning thread increments, so a plain load and store replaces the locked read-modify-write.
+    inline void bump(std::atomic<unsigned long long>& counter) noexcept {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    inline void record(const std::source_location& site, bool hit) {
+      site_table& table = local_table();
+      const std::size_t hash = reinterpret_cast<std::size_t>(site.file_name()) * 31 + site.line() * 131 + site.column();
+      for (std::size_t probe = 0; probe < site_table::capacity; ++probe) {
+        site_table::entry& e = table.entries[(hash + probe) % site_table::capacity];
+        const char* file = e.file.load(std::memory_order_relaxed);
+        if (!file) {
+          e.function = site.function_name();
+          e.line = site.line();
+          e.column = site.column();
+          e.file.store(site.file_name(), std::memory_order_release);
+        } else if (file != site.file_name() || e.line != site.line() || e.column != site.column()) {
+          continue;
+        }
+        bump(hit ? e.hits : e.empties);
+        return;
+      }
+      bump(table.dropped);
+    }
+
+    /// Prints the report when the program exits.
+    struct reporter {
+      ~reporter();
+    };
+
+  } // namespace detail::instrument
+
+
+  /// Returns the statistics of all call sites across all threads, sorted by descending empty count.
+  inline std::vector<optional_reference_site_stats> optional_reference_site_report() {
+    std::vector<optional_reference_site_stats> sites;
+    for (auto* table = detail::instrument::tables.load(std::memory_order_acquire); table; table = table->next) {
+      for (const auto& e : table->entries) {
+        const char* file = e.file.load(std::memory_order_acquire);
+        if (!file) continue;
+        auto merged = std::find_if(sites.begin(), sites.end(), [&](const optional_reference_site_stats& site) {
+          return site.line == e.line && site.column == e.column && std::strcmp(site.file, file) == 0;
+        });
+        if (merged == sites.end()) merged = sites.insert(sites.end(), { file, e.function, e.line, e.column, 0, 0 });
+        merged->hits += e.hits.load(std::memory_order_relaxed);
+        merged->empties += e.empties.load(std::memory_order_relaxed);
+      }
+    }
+    std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+      return a.empties != b.empties ? a.empties > b.empties : a.hits + a.empties > b.hits + b.empties;
+    });
+    return sites;
+  }
+
+  /// Prints the call site report to out.
+  inline void dump_optional_reference_report(std::FILE* out = stderr) {
+    std::fprintf(out, "optional_reference call sites (sorted by empty count):\n");
+    std::fprintf(out, "%12s %12s %8s  %s\n", "empty", "total", "empty%", "site");
+    for (const auto& site : optional_reference_site_report()) {
+      const unsigned long long total = site.hits + site.empties;
+      std::fprintf(out, "%12llu %12llu %7.2f%%  %s:%u:%u (%s)\n", site.empties, total,
+        total ? 100.0 * static_cast<double>(site.empties) / static_cast<double>(total) : 0.0, site.file, site.line,
+        site.column, site.function);
+    }
+    unsigned long long dropped = 0;
+    for (auto* table = detail::instrument::tables.load(std::memory_order_acquire); table; table = table->next) {
+      dropped += table->dropped.load(std::memory_order_relaxed);
+    }
+    if (dropped) std::fprintf(out, "%llu accesses from call sites over the table capacity were not counted\n", dropped);
+  }
+
+  inline detail::instrument::reporter::~reporter() {
+    dump_optional_reference_report();
+  }
+
+  namespace detail::instrument {
+
+    inline reporter report_at_exit;
+
+  } // namespace detail::instrument
+
+#endif
+
+
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+
+#ifndef DL_OPTIONAL_REFERENCE_LIFETIME_CAPACITY
+/// Number of slots in the registry of live objects. Must be a power of two.
+#define DL_OPTIONAL_REFERENCE_LIFETIME_CAPACITY (std::size_t(1) << 20)
+#endif
+
+  namespace detail::lifetime {
+
+    /// @brief Lock-free set of the addresses of live tracked objects.
+    /// @details An address may only live in the window of slots following its hash, so lookups never need to
+    /// scan past it and erased slots can be reused immediately without tombstones.
+    struct registry {
+      static constexpr std::size_t capacity = DL_OPTIONAL_REFERENCE_LIFETIME_CAPACITY;
+      static constexpr std::size_t window = 64;
+
+      static_assert((capacity & (capacity - 1)) == 0 && capacity >= window,
+        "DL_OPTIONAL_REFERENCE_LIFETIME_CAPACITY must be a power of two of at least 64");
+
+      alignas(64) std::atomic<std::uintptr_t> slots[capacity];
+
+      static std::size_t home(std::uintptr_t address) noexcept {
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(address >> 3) * 0x9E3779B97F4A7C15ull) >> 32)
+          & (capacity - 1);
+      }
+
+      bool insert(std::uintptr_t address) noexcept {
+        const std::size_t first = home(address);
+        for (std::size_t i = 0; i < window; ++i) {
+          std::atomic<std::uintptr_t>& slot = slots[(first + i) & (capacity - 1)];
+          std::uintptr_t expected = 0;
+          if (slot.load(std::memory_order_relaxed) == 0
+            && slot.compare_exchange_strong(expected, address, std::memory_order_release, std::memory_order_relaxed)) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      void erase(std::uintptr_t address) noexcept {
+        const std::size_t first = home(address);
+        for (std::size_t i = 0; i < window; ++i) {
+          std::atomic<std::uintptr_t>& slot = slots[(first + i) & (capacity - 1)];
+          std::uintptr_t expected = address;
+          if (slot.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed)) return;
+        }
+      }
+
+      bool contains(std::uintptr_t address) const noexcept {
+        const std::size_t first = home(address);
+        for (std::size_t i = 0; i < window; ++i) {
+          if (slots[(first + i) & (capacity - 1)].load(std::memory_order_acquire) == address) return true;
+        }
+        return false;
+      }
+    };
+
+    inline registry live;
+
+    inline void insert(const volatile void* object) noexcept {
+      if (!live.insert(reinterpret_cast<std::uintptr_t>(object))) {
+        std::fputs("optional_reference lifetime registry is full, raise DL_OPTIONAL_REFERENCE_LIFETIME_CAPACITY\n",
+          stderr);
+        std::abort();
+      }
+    }
+
+    inline void erase(const volatile void* object) noexcept {
+      live.erase(reinterpret_cast<std::uintptr_t>(object));
+    }
+
+    [[noreturn]] inline void default_dangling_handler(const void* address, const char* type) noexcept {
+      std::fprintf(stderr, "dangling optional_reference<%s> dereferenced (object at %p is not alive)\n", type, address);
+      std::abort();
+    }
+
+    inline std::atomic<void (*)(const void*, const char*)> dangling_handler{ default_dangling_handler };
+
+    [[gnu::cold]] inline void report_dangling(const void* address, const char* type) noexcept {
+      dangling_handler.load(std::memory_order_relaxed)(address, type);
+      std::abort();
+    }
+
+  } // namespace detail::lifetime
+
+
+  /// @brief Mixin base for objects whose lifetime is validated by optional_reference in debug builds.
+  /// @details Only available when DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS is defined. In that build, operator*,
+  /// operator-> and ref() of an optional_reference to a type that derives (non-virtually) from lifetime_tracked,
+  /// or for which is_lifetime_tracked is specialized, check that the referenced object is still alive and call the
+  /// dangling reference handler otherwise.
+  class lifetime_tracked {
+
+  protected:
+    /// Registers the object as alive.
+    lifetime_tracked() noexcept {
+      detail::lifetime::insert(this);
+    }
+
+    /// Registers the object as alive.
+    lifetime_tracked(const lifetime_tracked&) noexcept {
+      detail::lifetime::insert(this);
+    }
+
+    /// Object identity is unaffected by assignment.
+    lifetime_tracked& operator=(const lifetime_tracked&) noexcept {
+      return *this;
+    }
+
+    /// Unregisters the object.
+    ~lifetime_tracked() {
+      detail::lifetime::erase(this);
+    }
+
+  }; // class lifetime_tracked
+
+
+  namespace detail::lifetime {
+
+    // Incomplete types, such as opaque handles, are not tracked unless opted in explicitly.
+    template <class T, class = void>
+    struct derives_from_tracked : std::false_type {};
+
+    template <class T>
+    struct derives_from_tracked<T, std::void_t<decltype(sizeof(T))>> : std::is_base_of<lifetime_tracked, T> {};
+
+  } // namespace detail::lifetime
+
+
+  /// @brief Trait that opts a type into lifetime validation. Specialize it for types tracked by
+  /// lifetime_tracking_allocator.
+  /// @details A type that is incomplete where an optional_reference to it is dereferenced is not validated by default.
+  template <class T>
+  struct is_lifetime_tracked : detail::lifetime::derives_from_tracked<T> {};
+
+  template <class T>
+  inline constexpr bool is_lifetime_tracked_v = is_lifetime_tracked<std::remove_cv_t<T>>::value;
+
+
+  /// Allocator adaptor that registers every object it constructs with the lifetime registry.
+  template <class T, class Allocator = std::allocator<T>>
+  class lifetime_tracking_allocator : public Allocator {
+
+  public:
+    using value_type = T;
+
+    template <class U>
+    struct rebind {
+      using other = lifetime_tracking_allocator<U, typename std::allocator_traits<Allocator>::template rebind_alloc<U>>;
+    };
+
+    lifetime_tracking_allocator() = default;
+
+    lifetime_tracking_allocator(const Allocator& allocator) noexcept
+      : Allocator(allocator) {}
+
+    template <class U, class A>
+    lifetime_tracking_allocator(const lifetime_tracking_allocator<U, A>& other) noexcept
+      : Allocator(static_cast<const A&>(other)) {}
+
+    /// Constructs an object and registers it as alive.
+    template <class U, class... Args>
+    void construct(U* object, Args&&... args) {
+      std::allocator_traits<Allocator>::construct(static_cast<Allocator&>(*this), object, std::forward<Args>(args)...);
+      detail::lifetime::insert(object);
+    }
+
+    /// Unregisters an object and destroys it.
+    template <class U>
+    void destroy(U* object) noexcept {
+      detail::lifetime::erase(object);
+      std::allocator_traits<Allocator>::destroy(static_cast<Allocator&>(*this), object);
+    }
+
+  }; // template class lifetime_tracking_allocator
+
+
+  /// Replaces the function called when a dangling optional_reference is dereferenced. The handler must not return.
+  inline void set_dangling_reference_handler(void (*handler)(const void* address, const char* type)) noexcept {
+    detail::lifetime::dangling_handler.store(handler ? handler : detail::lifetime::default_dangling_handler,
+      std::memory_order_relaxed);
+  }
+
+#endif
+
+
+  namespace detail {
+
+    template <class Base, class Derived, class = void>
+    struct has_type_id_hook : std::false_type {};
+
+    template <class Base, class Derived>
+    struct has_type_id_hook<Base, Derived, std::void_t<decltype(std::declval<const Base&>().dynamic_type_id()
+      == std::remove_cv_t<Derived>::static_type_id)>> : std::true_type {};
+
+  } // namespace detail
+
+
   /// Raw pointer wrapper with std::optional-like semantics and safety against null dereferencing.
   template <class T>
-  class optional_reference {
+  class DL_TRIVIALLY_RELOCATABLE optional_reference {
 
   public:
+    /// Tells folly::IsRelocatable, and libraries following the same convention, that objects can be moved with memcpy.
+    using IsRelocatable = std::true_type;
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr optional_reference(std::source_location origin = std::source_location::current()) noexcept
+      : m_ptr(nullptr), m_origin(origin) {}
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr optional_reference(nullref_t,
+      std::source_location origin = std::source_location::current()) noexcept
+      : m_ptr(nullptr), m_origin(origin) {}
+
+    /// Constructs an object containing a reference.
+    [[nodiscard]] constexpr optional_reference(T& reference,
+      std::source_location origin = std::source_location::current()) noexcept
+      : m_ptr(std::addressof(reference)), m_origin(origin) {}
+
+    /// Constructs an object from a raw pointer.
+    [[nodiscard]] constexpr optional_reference(T* reference,
+      std::source_location origin = std::source_location::current()) noexcept
+      : m_ptr(reference), m_origin(origin) {}
+
+
+    /// Const conversion operator.
+    [[nodiscard]] constexpr operator optional_reference<const T>() const noexcept {
+      return optional_reference<const T>(m_ptr, m_origin);
+    }
+
+    /// Converts a reference to a derived class into a reference to this base class.
+    template <class U, std::enable_if_t<std::is_convertible_v<U*, T*>
+      && !std::is_same_v<std::remove_cv_t<U>, std::remove_cv_t<T>>, int> = 0>
+    [[nodiscard]] constexpr optional_reference(optional_reference<U> other) noexcept
+      : m_ptr(other.ptr()), m_origin(other.origin()) {}
+
+
+    /// Returns where *this (or the object it was copied from) was created or last reset.
+    [[nodiscard]] constexpr std::source_location origin() const noexcept {
+      return m_origin;
+    }
+#else
     /// Constructs an object that does not contain a reference.
     [[nodiscard]] constexpr optional_reference() noexcept
       : m_ptr(nullptr) {}
@@ -77,16 +681,31 @@ namespace dl {
       return optional_reference<const T>(m_ptr);
     }
 
+    /// Converts a reference to a derived class into a reference to this base class.
+    template <class U, std::enable_if_t<std::is_convertible_v<U*, T*>
+      && !std::is_same_v<std::remove_cv_t<U>, std::remove_cv_t<T>>, int> = 0>
+    [[nodiscard]] constexpr optional_reference(optional_reference<U> other) noexcept
+      : m_ptr(other.ptr()) {}
+#endif
+
 
     /// Returns true if *this contains a reference, false otherwise.
     [[nodiscard]] constexpr operator bool() const noexcept {
       return m_ptr;
     }
 
+#ifdef DL_OPTIONAL_REFERENCE_INSTRUMENT
+    /// Returns true if *this contains a reference, false otherwise.
+    [[nodiscard]] constexpr bool has_ref(std::source_location call_site = std::source_location::current()) const {
+      if (!std::is_constant_evaluated()) detail::instrument::record(call_site, m_ptr);
+      return m_ptr;
+    }
+#else
     /// Returns true if *this contains a reference, false otherwise.
     [[nodiscard]] constexpr bool has_ref() const noexcept {
       return m_ptr;
     }
+#endif
 
 
     /// @brief Returns the contained reference.
@@ -94,13 +713,39 @@ namespace dl {
     /// unapologetically dereference a null pointer without throwing an exception.
     [[nodiscard]] constexpr T& operator*() const noexcept {
       assert(m_ptr);
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+      validate_lifetime();
+#endif
       return *m_ptr;
     }
 
     /// @brief Returns the contained reference.
     /// @exception bad_optional_reference_access - If *this is empty.
+#ifdef DL_OPTIONAL_REFERENCE_CALL_SITE
+    [[nodiscard]] constexpr T& ref(std::source_location call_site = std::source_location::current()) const {
+#else
     [[nodiscard]] constexpr T& ref() const {
-      if (!m_ptr) throw bad_optional_reference_access();
+#endif
+#ifdef DL_OPTIONAL_REFERENCE_INSTRUMENT
+      if (!std::is_constant_evaluated()) detail::instrument::record(call_site, m_ptr);
+#endif
+      if (!m_ptr) {
+#ifdef DL_OPTIONAL_REFERENCE_TRACE
+        detail::trace::bad_access(call_site, detail::type_name<T>.data());
+#endif
+#if defined(DL_OPTIONAL_REFERENCE_TRACK_ORIGIN) && defined(DL_OPTIONAL_REFERENCE_TRACE)
+        throw bad_optional_reference_access(m_origin, detail::type_name<T>.data(), call_site);
+#elif defined(DL_OPTIONAL_REFERENCE_TRACK_ORIGIN)
+        throw bad_optional_reference_access(m_origin);
+#elif defined(DL_OPTIONAL_REFERENCE_TRACE)
+        throw bad_optional_reference_access(detail::type_name<T>.data(), call_site);
+#else
+        throw bad_optional_reference_access();
+#endif
+      }
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+      validate_lifetime();
+#endif
       return *m_ptr;
     }
 
@@ -108,6 +753,9 @@ namespace dl {
     /// @details Note that this function is unchecked and can return nullptr if *this is empty.
     [[nodiscard]] constexpr T* operator->() const noexcept {
       assert(m_ptr);
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+      validate_lifetime();
+#endif
       return m_ptr;
     }
 
@@ -117,17 +765,157 @@ namespace dl {
     }
 
 
+    /// @brief Returns a reference to the referenced object as the derived class U, or an empty reference if *this is
+    /// empty or the object is not a U.
+    /// @details If T has a dynamic_type_id() member function and U a static constexpr static_type_id member, the
+    /// check is a single comparison of the two, which matches only objects whose most derived type is U. Otherwise,
+    /// T must be polymorphic and dynamic_cast is used.
+    template <class U>
+    [[nodiscard]] constexpr optional_reference<U> as() const {
+      static_assert(std::is_base_of_v<std::remove_cv_t<T>, std::remove_cv_t<U>>, "U must be derived from T");
+      if (!m_ptr) return nullref;
+      if constexpr (detail::has_type_id_hook<T, U>::value) {
+        if (m_ptr->dynamic_type_id() != std::remove_cv_t<U>::static_type_id) return nullref;
+        return static_cast<U*>(m_ptr);
+      } else {
+        static_assert(std::is_polymorphic_v<T>, "T must be polymorphic or provide the dynamic_type_id() hook");
+        return dynamic_cast<U*>(m_ptr);
+      }
+    }
+
+
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+    /// If *this contains a reference, resets it to being empty.
+    constexpr void reset(std::source_location origin = std::source_location::current()) noexcept {
+      m_ptr = nullptr;
+      m_origin = origin;
+    }
+#else
     /// If *this contains a reference, resets it to being empty.
     constexpr void reset() noexcept {
       m_ptr = nullptr;
     }
+#endif
 
   private:
+#ifdef DL_OPTIONAL_REFERENCE_LIFETIME_CHECKS
+    constexpr void validate_lifetime() const noexcept {
+      if constexpr (is_lifetime_tracked_v<T>) {
+        if (std::is_constant_evaluated() || !m_ptr) return;
+        const volatile void* address;
+        if constexpr (detail::lifetime::derives_from_tracked<std::remove_cv_t<T>>::value) {
+          address = static_cast<const volatile lifetime_tracked*>(m_ptr);
+        } else {
+          address = const_cast<const std::remove_cv_t<T>*>(m_ptr);
+        }
+        if (!detail::lifetime::live.contains(reinterpret_cast<std::uintptr_t>(address))) [[unlikely]] {
+          detail::lifetime::report_dangling(m_ptr, detail::type_name<T>.data());
+        }
+      }
+    }
+#endif
+
     T* m_ptr;
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+    std::source_location m_origin;
+#endif
 
   }; // template class optional_reference
 
+  namespace detail {
+
+    /// Checks the properties that let optional_reference<T> be passed and returned in a register exactly like T*.
+    /// Under the Itanium C++ ABI (SysV x86-64, AArch64) a class is passed in registers only if its copy and move
+    /// constructors and destructor are trivial, and it is classified like a pointer only if it has the same size and
+    /// alignment as one.
+    template <class T>
+    constexpr bool check_abi() noexcept {
+      using ref = optional_reference<T>;
+      static_assert(std::is_trivially_copy_constructible_v<ref> && std::is_trivially_move_constructible_v<ref>,
+        "optional_reference must be trivially copy and move constructible");
+      static_assert(std::is_trivially_copy_assignable_v<ref> && std::is_trivially_move_assignable_v<ref>,
+        "optional_reference must be trivially copy and move assignable");
+      static_assert(std::is_trivially_destructible_v<ref>, "optional_reference must be trivially destructible");
+      static_assert(std::is_trivially_copyable_v<ref>, "optional_reference must be trivially copyable");
+      static_assert(std::is_standard_layout_v<ref>, "optional_reference must be standard-layout");
+#ifndef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+      static_assert(sizeof(ref) == sizeof(T*), "optional_reference must be pointer-sized");
+      static_assert(alignof(ref) == alignof(T*), "optional_reference must be aligned like a pointer");
+#endif
+      return true;
+    }
+
+    struct abi_incomplete;
+
+    static_assert(check_abi<int>() && check_abi<const int>() && check_abi<abi_incomplete>()
+      && check_abi<void (*)()>());
+
+  } // namespace detail
+
+
+  /// @brief Trait telling whether moving an object to a new address and ending the old one's lifetime can be done
+  /// with memcpy.
+  /// @details Uses the compiler's notion of trivial relocatability where available and falls back to trivial
+  /// copyability. Specialize it for other types that are safe to relocate bitwise.
+  template <class T>
+  struct is_trivially_relocatable
+#if defined(__has_builtin)
+#if __has_builtin(__is_trivially_relocatable)
+    : std::bool_constant<__is_trivially_relocatable(T)> {};
+#define DL_HAS_TRIVIALLY_RELOCATABLE_BUILTIN
+#endif
+#endif
+#ifndef DL_HAS_TRIVIALLY_RELOCATABLE_BUILTIN
+    : std::is_trivially_copyable<T> {};
+#endif
+#undef DL_HAS_TRIVIALLY_RELOCATABLE_BUILTIN
+
+  template <class T>
+  struct is_trivially_relocatable<optional_reference<T>> : std::true_type {};
+
+  template <class T>
+  inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+
+  /// @brief Relocates count objects from first into the uninitialized storage at dest.
+  /// @details Afterwards, the objects at first are no longer alive. The ranges may overlap. Trivially relocatable
+  /// types are moved with a single memmove, other types are move-constructed and destroyed one by one, in an order
+  /// that is safe for overlap.
+  template <class T>
+  T* relocate(T* first, std::size_t count, T* dest) noexcept(is_trivially_relocatable_v<T>
+    || std::is_nothrow_move_constructible_v<T>) {
+    if constexpr (is_trivially_relocatable_v<T>) {
+      if (count != 0) std::memmove(static_cast<void*>(dest), static_cast<const void*>(first), count * sizeof(T));
+    } else if (dest < first) {
+      for (std::size_t i = 0; i < count; ++i) {
+        ::new (static_cast<void*>(dest + i)) T(std::move(first[i]));
+        first[i].~T();
+      }
+    } else if (dest > first) {
+      for (std::size_t i = count; i-- > 0;) {
+        ::new (static_cast<void*>(dest + i)) T(std::move(first[i]));
+        first[i].~T();
+      }
+    }
+    return dest + count;
+  }
+
 
+#ifdef DL_OPTIONAL_REFERENCE_TRACK_ORIGIN
+  /// Returns an optional_reference object holding the passed reference.
+  template <class T>
+  [[nodiscard]] constexpr optional_reference<T> opt_ref(T& reference,
+    std::source_location origin = std::source_location::current()) noexcept {
+    return optional_reference<T>(reference, origin);
+  }
+
+  /// Returns an optional_reference object holding an immutable version of the passed reference.
+  template <class T>
+  [[nodiscard]] constexpr optional_reference<const T> opt_cref(const T& reference,
+    std::source_location origin = std::source_location::current()) noexcept {
+    return optional_reference<const T>(reference, origin);
+  }
+#else
   /// Returns an optional_reference object holding the passed reference.
   template <class T>
   [[nodiscard]] constexpr optional_reference<T> opt_ref(T& reference) noexcept {
@@ -139,6 +927,61 @@ namespace dl {
   [[nodiscard]] constexpr optional_reference<const T> opt_cref(const T& reference) noexcept {
     return optional_reference<const T>(reference);
   }
+#endif
+
+
+  /// @brief Hints the processor to start loading the referenced object into the cache.
+  /// @details Has no effect on program behavior and is harmless for empty references.
+  template <class T>
+  inline void prefetch(optional_reference<T> reference) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(const_cast<const void*>(static_cast<const volatile void*>(reference.ptr())));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char*>(const_cast<const void*>(static_cast<const volatile void*>(reference.ptr()))),
+      _MM_HINT_T0);
+#else
+    (void)reference;
+#endif
+  }
+
+
+#if defined(__cpp_lib_span) && !defined(DL_OPTIONAL_REFERENCE_TRACK_ORIGIN)
+  /// @brief Views an array of raw pointers as an array of optional_references without copying.
+  /// @details Relies on optional_reference<T> having exactly the layout of T*, which is statically asserted.
+  template <class T, std::size_t Extent>
+  [[nodiscard]] std::span<optional_reference<T>, Extent> as_optional_refs(std::span<T*, Extent> pointers) noexcept {
+    static_assert(detail::check_abi<T>());
+    return std::span<optional_reference<T>, Extent>(reinterpret_cast<optional_reference<T>*>(pointers.data()),
+      pointers.size());
+  }
+
+  /// @brief Views an array of raw pointers as an array of optional_references without copying.
+  /// @details Relies on optional_reference<T> having exactly the layout of T*, which is statically asserted.
+  template <class T, std::size_t Extent>
+  [[nodiscard]] std::span<const optional_reference<T>, Extent> as_optional_refs(
+    std::span<T* const, Extent> pointers) noexcept {
+    static_assert(detail::check_abi<T>());
+    return std::span<const optional_reference<T>, Extent>(
+      reinterpret_cast<const optional_reference<T>*>(pointers.data()), pointers.size());
+  }
+
+  /// @brief Views an array of optional_references as an array of raw pointers without copying.
+  /// @details Empty references appear as nullptr.
+  template <class T, std::size_t Extent>
+  [[nodiscard]] std::span<T*, Extent> as_pointers(std::span<optional_reference<T>, Extent> references) noexcept {
+    static_assert(detail::check_abi<T>());
+    return std::span<T*, Extent>(reinterpret_cast<T**>(references.data()), references.size());
+  }
+
+  /// @brief Views an array of optional_references as an array of raw pointers without copying.
+  /// @details Empty references appear as nullptr.
+  template <class T, std::size_t Extent>
+  [[nodiscard]] std::span<T* const, Extent> as_pointers(
+    std::span<const optional_reference<T>, Extent> references) noexcept {
+    static_assert(detail::check_abi<T>());
+    return std::span<T* const, Extent>(reinterpret_cast<T* const*>(references.data()), references.size());
+  }
+#endif
 
 } // namespace dl
 
@@ -0,0 +1,149 @@
+
+/// @brief Optional span class: an optional_reference to a contiguous array.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_OPTIONAL_SPAN_HPP
+#define DL_OPTIONAL_SPAN_HPP
+
+#include "optional_reference.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <ranges>
+#include <span>
+#include <type_traits>
+
+
+namespace dl {
+
+  /// @brief Pointer and length pair with optional_reference-like semantics.
+  /// @details Distinguishes "no buffer" from a buffer of zero elements: the empty state is encoded in the length, so a
+  /// present buffer may have any data pointer, including nullptr for an empty std::vector.
+  template <class T>
+  class optional_span {
+
+  public:
+    using element_type = T;
+    using size_type = std::size_t;
+
+
+    /// Constructs an object that does not contain a span.
+    [[nodiscard]] constexpr optional_span() noexcept
+      : m_data(nullptr), m_size(npos) {}
+
+    /// Constructs an object that does not contain a span.
+    [[nodiscard]] constexpr optional_span(nullref_t) noexcept
+      : m_data(nullptr), m_size(npos) {}
+
+    /// Constructs an object containing the size elements starting at data, such as a memory-mapped region.
+    [[nodiscard]] constexpr optional_span(T* data, size_type size) noexcept
+      : m_data(data), m_size(size) {
+      assert(size != npos);
+    }
+
+    /// Constructs an object containing the passed span.
+    template <std::size_t Extent>
+    [[nodiscard]] constexpr optional_span(std::span<T, Extent> span) noexcept
+      : m_data(span.data()), m_size(span.size()) {}
+
+    /// Constructs an object containing the elements of a contiguous container such as std::vector or std::array.
+    template <class R>
+      requires std::ranges::contiguous_range<R> && std::ranges::sized_range<R> && std::ranges::borrowed_range<R>
+        && std::is_convertible_v<std::remove_reference_t<std::ranges::range_reference_t<R>>(*)[], T(*)[]>
+        && (!std::is_same_v<std::remove_cvref_t<R>, optional_span>)
+    [[nodiscard]] constexpr optional_span(R&& range) noexcept(noexcept(std::ranges::data(range)))
+      : m_data(std::ranges::data(range)), m_size(std::ranges::size(range)) {}
+
+
+    /// Const conversion operator.
+    [[nodiscard]] constexpr operator optional_span<const T>() const noexcept {
+      return m_size != npos ? optional_span<const T>(m_data, m_size) : optional_span<const T>();
+    }
+
+
+    /// Returns true if *this contains a span, false otherwise.
+    [[nodiscard]] constexpr operator bool() const noexcept {
+      return m_size != npos;
+    }
+
+    /// Returns true if *this contains a span, false otherwise.
+    [[nodiscard]] constexpr bool has_ref() const noexcept {
+      return m_size != npos;
+    }
+
+
+    /// @brief Returns the contained span.
+    /// @details Unlike optional_span::ref, this operator is unchecked.
+    [[nodiscard]] constexpr std::span<T> operator*() const noexcept {
+      assert(m_size != npos);
+      return std::span<T>(m_data, m_size);
+    }
+
+    /// @brief Returns the contained span.
+    /// @exception bad_optional_reference_access - If *this is empty.
+    [[nodiscard]] constexpr std::span<T> ref() const {
+      if (m_size == npos) throw bad_optional_reference_access();
+      return std::span<T>(m_data, m_size);
+    }
+
+    /// Returns the contained span, or an empty span if *this is empty.
+    [[nodiscard]] constexpr std::span<T> span_or_empty() const noexcept {
+      return std::span<T>(m_data, m_size != npos ? m_size : 0);
+    }
+
+
+    /// Returns a pointer to the first element, or nullptr if *this is empty.
+    [[nodiscard]] constexpr T* data() const noexcept {
+      return m_data;
+    }
+
+    /// Returns the number of elements, or 0 if *this is empty.
+    [[nodiscard]] constexpr size_type size() const noexcept {
+      return m_size != npos ? m_size : 0;
+    }
+
+
+    /// If *this contains a span, resets it to being empty.
+    constexpr void reset() noexcept {
+      m_data = nullptr;
+      m_size = npos;
+    }
+
+  private:
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    T* m_data;
+    size_type m_size;
+
+  }; // template class optional_span
+
+
+  template <class T, std::size_t Extent>
+  optional_span(std::span<T, Extent>) -> optional_span<T>;
+
+  template <class R>
+  optional_span(R&&) -> optional_span<std::remove_reference_t<std::ranges::range_reference_t<R>>>;
+
+
+  static_assert(sizeof(optional_span<int>) == 2 * sizeof(void*), "optional_span must be two words");
+  static_assert(std::is_trivially_copyable_v<optional_span<int>>, "optional_span must be trivially copyable");
+
+} // namespace dl
+
+#endif // !DL_OPTIONAL_SPAN_HPP
@@ -0,0 +1,204 @@
+
+/// @brief Pointer-sized optional reference to one of several types.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_OPTIONAL_VARIANT_REFERENCE_HPP
+#define DL_OPTIONAL_VARIANT_REFERENCE_HPP
+
+#include "optional_reference.hpp"
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  /// @brief Optional reference to an object of one of the types Ts, encoded in a single tagged pointer.
+  /// @details The index of the referenced alternative is stored in the low bits of the pointer, which are always zero
+  /// for sufficiently aligned types, so up to 16 alternatives fit in one word. Dispatching with visit() switches on
+  /// that index instead of loading a vtable pointer from the referenced object.
+  template <class... Ts>
+  class optional_variant_reference {
+
+  public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr optional_variant_reference() noexcept
+      : m_bits(0) {}
+
+    /// Constructs an object that does not contain a reference.
+    [[nodiscard]] constexpr optional_variant_reference(nullref_t) noexcept
+      : m_bits(0) {}
+
+    /// Constructs an object containing a reference to one of the alternatives.
+    template <class U>
+      requires (std::is_same_v<U, Ts> || ...)
+    [[nodiscard]] optional_variant_reference(U& reference) noexcept
+      : m_bits(reinterpret_cast<std::uintptr_t>(std::addressof(reference)) | index_of<U>) {
+      static_assert(aligned<U>, "every alternative must be aligned to at least the number of alternatives rounded "
+        "up to a power of two");
+    }
+
+    /// Constructs an object from a raw pointer to one of the alternatives. A null pointer produces an empty object.
+    template <class U>
+      requires (std::is_same_v<U, Ts> || ...)
+    [[nodiscard]] optional_variant_reference(U* reference) noexcept
+      : m_bits(reference ? reinterpret_cast<std::uintptr_t>(reference) | index_of<U> : 0) {
+      static_assert(aligned<U>, "every alternative must be aligned to at least the number of alternatives rounded "
+        "up to a power of two");
+    }
+
+
+    /// Returns true if *this contains a reference, false otherwise.
+    [[nodiscard]] constexpr operator bool() const noexcept {
+      return m_bits != 0;
+    }
+
+    /// Returns true if *this contains a reference, false otherwise.
+    [[nodiscard]] constexpr bool has_ref() const noexcept {
+      return m_bits != 0;
+    }
+
+    /// Returns the index of the referenced alternative, or npos if *this is empty.
+    [[nodiscard]] constexpr std::size_t index() const noexcept {
+      return m_bits != 0 ? static_cast<std::size_t>(m_bits & index_mask) : npos;
+    }
+
+    /// Returns true if *this refers to an object of type U.
+    template <class U>
+    [[nodiscard]] constexpr bool holds_alternative() const noexcept {
+      return m_bits != 0 && (m_bits & index_mask) == index_of<U>;
+    }
+
+
+    /// Returns a reference to the referenced object if it is of type U, or an empty reference otherwise.
+    template <class U>
+    [[nodiscard]] optional_reference<U> get_if() const noexcept {
+      return holds_alternative<U>() ? optional_reference<U>(pointer<U>()) : nullref;
+    }
+
+    /// @brief Returns the referenced object, which must be of type U.
+    /// @exception bad_optional_reference_access - If *this is empty or refers to another alternative.
+    template <class U>
+    [[nodiscard]] U& get() const {
+      if (!holds_alternative<U>()) throw bad_optional_reference_access();
+      return *pointer<U>();
+    }
+
+
+    /// @brief Calls f with the referenced object and returns the result.
+    /// @details All alternatives must produce the same result type. The dispatch is a switch on the stored index.
+    /// @exception bad_optional_reference_access - If *this is empty.
+    template <class F>
+    decltype(auto) visit(F&& f) const {
+      if (m_bits == 0) throw bad_optional_reference_access();
+      return visit_unchecked(std::forward<F>(f));
+    }
+
+    /// @brief Calls f with the referenced object and returns the result.
+    /// @details Unlike optional_variant_reference::visit, this function is unchecked.
+    template <class F>
+    decltype(auto) visit_unchecked(F&& f) const {
+      assert(m_bits != 0);
+      using result = std::invoke_result_t<F, alternative<0>&>;
+      static_assert((std::is_same_v<result, std::invoke_result_t<F, Ts&>> && ...),
+        "visitor must return the same type for every alternative");
+
+      switch (m_bits & index_mask) {
+      case 0: return call<0>(f);
+      case 1: if constexpr (1 < count) return call<1>(f); break;
+      case 2: if constexpr (2 < count) return call<2>(f); break;
+      case 3: if constexpr (3 < count) return call<3>(f); break;
+      case 4: if constexpr (4 < count) return call<4>(f); break;
+      case 5: if constexpr (5 < count) return call<5>(f); break;
+      case 6: if constexpr (6 < count) return call<6>(f); break;
+      case 7: if constexpr (7 < count) return call<7>(f); break;
+      case 8: if constexpr (8 < count) return call<8>(f); break;
+      case 9: if constexpr (9 < count) return call<9>(f); break;
+      case 10: if constexpr (10 < count) return call<10>(f); break;
+      case 11: if constexpr (11 < count) return call<11>(f); break;
+      case 12: if constexpr (12 < count) return call<12>(f); break;
+      case 13: if constexpr (13 < count) return call<13>(f); break;
+      case 14: if constexpr (14 < count) return call<14>(f); break;
+      case 15: if constexpr (15 < count) return call<15>(f); break;
+      }
+#if defined(__GNUC__) || defined(__clang__)
+      __builtin_unreachable();
+#elif defined(_MSC_VER)
+      __assume(false);
+#endif
+    }
+
+
+    /// If *this contains a reference, resets it to being empty.
+    constexpr void reset() noexcept {
+      m_bits = 0;
+    }
+
+  private:
+    static constexpr std::size_t count = sizeof...(Ts);
+    static constexpr std::size_t index_bits = count > 1 ? std::bit_width(count - 1) : 0;
+    static constexpr std::uintptr_t index_mask = (std::uintptr_t(1) << index_bits) - 1;
+
+    static_assert(count > 0 && count <= 16, "optional_variant_reference supports 1 to 16 alternatives");
+
+    // Checked where an address is stored rather than in the class body, so that an alternative may contain an
+    // optional_variant_reference to itself, as recursive AST nodes do.
+    template <class U>
+    static constexpr bool aligned = alignof(U) >= (std::size_t(1) << index_bits);
+
+    template <std::size_t I>
+    using alternative = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template <class U, std::size_t... I>
+    static constexpr std::uintptr_t find_index(std::index_sequence<I...>) noexcept {
+      static_assert((std::is_same_v<U, Ts> + ...) == 1, "U must be exactly one of the alternatives");
+      return ((std::is_same_v<U, Ts> ? I : 0) + ...);
+    }
+
+    template <class U>
+    static constexpr std::uintptr_t index_of = find_index<U>(std::index_sequence_for<Ts...>());
+
+
+    template <class U>
+    U* pointer() const noexcept {
+      return reinterpret_cast<U*>(m_bits & ~index_mask);
+    }
+
+    template <std::size_t I, class F>
+    decltype(auto) call(F& f) const {
+      return f(*pointer<alternative<I>>());
+    }
+
+
+    std::uintptr_t m_bits;
+
+  }; // template class optional_variant_reference
+
+} // namespace dl
+
+#endif // !DL_OPTIONAL_VARIANT_REFERENCE_HPP
@@ -0,0 +1,267 @@
+
+/// @brief Bounded non-blocking queues of optional_reference for handing objects between threads.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_REF_QUEUE_HPP
+#define DL_REF_QUEUE_HPP
+
+#include "optional_reference.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace dl {
+
+  namespace detail {
+
+    [[nodiscard]] inline std::size_t ring_capacity(std::size_t capacity) noexcept {
+      return std::bit_ceil(std::max<std::size_t>(capacity, 1));
+    }
+
+  } // namespace detail
+
+
+  /// @brief Bounded wait-free queue of references between one producer thread and one consumer thread.
+  /// @details A slot holding nullptr is free, so each side only needs its own index: the producer waits for the slot
+  /// at its index to become empty and the consumer for it to become full. The two indices live on separate cache
+  /// lines and are never read by the other side, so in steady state the only shared traffic is the slots themselves.
+  template <class T>
+  class spsc_ref_queue {
+
+  public:
+    /// Constructs an empty queue holding at least capacity references.
+    [[nodiscard]] explicit spsc_ref_queue(std::size_t capacity)
+      : m_mask(detail::ring_capacity(capacity) - 1), m_slots(std::make_unique<std::atomic<T*>[]>(m_mask + 1)),
+        m_tail(0), m_head(0) {}
+
+    spsc_ref_queue(const spsc_ref_queue&) = delete;
+    spsc_ref_queue& operator=(const spsc_ref_queue&) = delete;
+
+
+    /// Appends a reference to object. Returns false if the queue is full.
+    [[nodiscard]] bool try_push(T& object) noexcept {
+      std::atomic<T*>& slot = this->slot(m_tail);
+      if (slot.load(std::memory_order_acquire)) return false;
+      slot.store(std::addressof(object), std::memory_order_release);
+      ++m_tail;
+      return true;
+    }
+
+    /// @brief Appends the references in [first, last) until the queue fills up. Empty references are skipped.
+    /// @return An iterator to the first element that was not consumed, or last if every element was.
+    template <class InputIt>
+    InputIt try_push(InputIt first, InputIt last) noexcept {
+      for (; first != last; ++first) {
+        const optional_reference<T> object = *first;
+        if (!object) continue;
+        std::atomic<T*>& slot = this->slot(m_tail);
+        if (slot.load(std::memory_order_acquire)) break;
+        slot.store(object.ptr(), std::memory_order_release);
+        ++m_tail;
+      }
+      return first;
+    }
+
+
+    /// Removes and returns the oldest reference, or an empty reference if the queue is empty.
+    [[nodiscard]] optional_reference<T> try_pop() noexcept {
+      std::atomic<T*>& slot = this->slot(m_head);
+      T* object = slot.load(std::memory_order_acquire);
+      if (!object) return nullref;
+      slot.store(nullptr, std::memory_order_release);
+      ++m_head;
+      return object;
+    }
+
+    /// @brief Removes up to max references and writes them to out, oldest first.
+    /// @return The number of references popped.
+    template <class OutputIt>
+    std::size_t try_pop(OutputIt out, std::size_t max) {
+      std::size_t count = 0;
+      for (; count < max; ++count) {
+        std::atomic<T*>& slot = this->slot(m_head + count);
+        T* object = slot.load(std::memory_order_acquire);
+        if (!object) break;
+        slot.store(nullptr, std::memory_order_release);
+        *out++ = optional_reference<T>(object);
+      }
+      m_head += count;
+      return count;
+    }
+
+
+    /// Returns the number of references the queue can hold, which is the requested capacity rounded up to a power of 2.
+    [[nodiscard]] std::size_t capacity() const noexcept {
+      return static_cast<std::size_t>(m_mask + 1);
+    }
+
+  private:
+    [[nodiscard]] std::atomic<T*>& slot(std::uint64_t index) const noexcept {
+      return m_slots[index & m_mask];
+    }
+
+
+    const std::uint64_t m_mask;
+    const std::unique_ptr<std::atomic<T*>[]> m_slots;
+    alignas(64) std::uint64_t m_tail;
+    alignas(64) std::uint64_t m_head;
+
+  }; // template class spsc_ref_queue
+
+
+  /// @brief Bounded queue of references between any number of producer and consumer threads.
+  /// @details Each slot carries a sequence number telling which lap of the ring it is ready for, in the style of
+  /// Vyukov's bounded queue. A producer or consumer checks the sequence numbers of the slots it wants, claims all of
+  /// the ready ones at once by advancing the padded tail or head counter with a CAS, and only then fills or drains
+  /// them. No call ever waits for another thread: if the next slot is still being filled or drained, the call fails
+  /// as if the queue were empty or full.
+  template <class T>
+  class mpmc_ref_queue {
+
+  public:
+    /// Constructs an empty queue holding at least capacity references.
+    [[nodiscard]] explicit mpmc_ref_queue(std::size_t capacity)
+      : m_mask(detail::ring_capacity(capacity) - 1), m_slots(std::make_unique<slot[]>(m_mask + 1)), m_tail(0),
+        m_head(0) {
+      for (std::uint64_t i = 0; i <= m_mask; ++i) m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    mpmc_ref_queue(const mpmc_ref_queue&) = delete;
+    mpmc_ref_queue& operator=(const mpmc_ref_queue&) = delete;
+
+
+    /// Appends a reference to object. Returns false if the queue is full.
+    [[nodiscard]] bool try_push(T& object) noexcept {
+      T* pointer = std::addressof(object);
+      return try_push(&pointer, &pointer + 1) != &pointer;
+    }
+
+    /// @brief Appends the references in [first, last), claiming as many free slots as possible in one step. Empty
+    /// references are skipped.
+    /// @return An iterator to the first element that was not consumed, or last if every element was.
+    template <class ForwardIt>
+    ForwardIt try_push(ForwardIt first, ForwardIt last) noexcept {
+      std::uint64_t wanted = 0;
+      for (ForwardIt it = first; it != last; ++it) wanted += optional_reference<T>(*it).has_ref();
+      if (wanted == 0) return last;
+
+      std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+      std::uint64_t count;
+      for (;;) {
+        count = ready(tail, wanted, 0);
+        if (count == 0) {
+          if (lap(tail, 0) < 0) return first;
+          tail = m_tail.load(std::memory_order_relaxed);
+        } else if (m_tail.compare_exchange_weak(tail, tail + count, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+
+      for (std::uint64_t i = 0; i < count; ++first) {
+        const optional_reference<T> object = *first;
+        if (!object) continue;
+        slot& target = this->at(tail + i);
+        target.object = object.ptr();
+        target.sequence.store(tail + i + 1, std::memory_order_release);
+        ++i;
+      }
+      while (first != last && !optional_reference<T>(*first)) ++first;
+      return first;
+    }
+
+
+    /// Removes and returns the oldest reference, or an empty reference if the queue is empty.
+    [[nodiscard]] optional_reference<T> try_pop() noexcept {
+      optional_reference<T> object;
+      try_pop(&object, 1);
+      return object;
+    }
+
+    /// @brief Removes up to max references and writes them to out, claiming as many as are ready in one step.
+    /// @return The number of references popped.
+    template <class OutputIt>
+    std::size_t try_pop(OutputIt out, std::size_t max) {
+      if (max == 0) return 0;
+      std::uint64_t head = m_head.load(std::memory_order_relaxed);
+      std::uint64_t count;
+      for (;;) {
+        count = ready(head, max, 1);
+        if (count == 0) {
+          if (lap(head, 1) < 0) return 0;
+          head = m_head.load(std::memory_order_relaxed);
+        } else if (m_head.compare_exchange_weak(head, head + count, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+
+      for (std::uint64_t i = 0; i < count; ++i) {
+        slot& source = this->at(head + i);
+        T* const object = source.object;
+        source.sequence.store(head + i + m_mask + 1, std::memory_order_release);
+        *out++ = optional_reference<T>(object);
+      }
+      return static_cast<std::size_t>(count);
+    }
+
+
+    /// Returns the number of references the queue can hold, which is the requested capacity rounded up to a power of 2.
+    [[nodiscard]] std::size_t capacity() const noexcept {
+      return static_cast<std::size_t>(m_mask + 1);
+    }
+
+  private:
+    struct slot {
+      std::atomic<std::uint64_t> sequence;
+      T* object;
+    };
+
+
+    [[nodiscard]] slot& at(std::uint64_t index) const noexcept {
+      return m_slots[index & m_mask];
+    }
+
+    /// Compares the sequence number of the slot at position with the one it has when ready for position (plus offset
+    /// 1 once filled): negative means the slot is still a lap behind, positive that position has been claimed already.
+    [[nodiscard]] std::int64_t lap(std::uint64_t position, std::uint64_t offset) const noexcept {
+      return static_cast<std::int64_t>(at(position).sequence.load(std::memory_order_acquire) - (position + offset));
+    }
+
+    /// Returns how many consecutive slots starting at position, up to max, are ready.
+    [[nodiscard]] std::uint64_t ready(std::uint64_t position, std::uint64_t max, std::uint64_t offset) const noexcept {
+      std::uint64_t count = 0;
+      while (count < max && count <= m_mask && lap(position + count, offset) == 0) ++count;
+      return count;
+    }
+
+
+    const std::uint64_t m_mask;
+    const std::unique_ptr<slot[]> m_slots;
+    alignas(64) std::atomic<std::uint64_t> m_tail;
+    alignas(64) std::atomic<std::uint64_t> m_head;
+
+  }; // template class mpmc_ref_queue
+
+} // namespace dl
+
+#endif // !DL_REF_QUEUE_HPP
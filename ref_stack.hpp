@@ -0,0 +1,217 @@
+
+/// @brief Intrusive lock-free stack linked through optional_reference members, and an object pool built on it.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_REF_STACK_HPP
+#define DL_REF_STACK_HPP
+
+#include "optional_reference.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  /// @brief Intrusive Treiber stack whose nodes are linked through an optional_reference<Node> member.
+  /// @details The head is a single 64-bit word holding the top node's address together with a tag that is bumped by
+  /// every update, so a pop cannot succeed against a head that was popped and pushed back in between (the ABA
+  /// problem). On 64-bit targets the tag takes the 16 bits above the 48-bit user address space; a node whose address
+  /// uses those bits (5-level paging, pointer tagging) prints a diagnostic and aborts as soon as it would become the
+  /// head, whether by push() or, for the inner nodes of a pushed chain, by pop(). A pop may read the link of a node
+  /// that another thread has just popped, so nodes must stay mapped while the stack is in use, as they do in a pool;
+  /// the stack never touches anything but the link member.
+  template <class Node, optional_reference<Node> Node::*Next = &Node::next>
+  class ref_stack {
+
+  public:
+    /// Constructs an empty stack.
+    [[nodiscard]] constexpr ref_stack() noexcept
+      : m_head(0) {}
+
+    ref_stack(const ref_stack&) = delete;
+    ref_stack& operator=(const ref_stack&) = delete;
+
+
+    /// Pushes node on top of the stack.
+    void push(Node& node) noexcept {
+      push(node, node);
+    }
+
+    /// @brief Pushes a chain of nodes in one step.
+    /// @details The nodes from first to last must already be linked through their Next members; the link of last is
+    /// overwritten, and first ends up on top of the stack.
+    void push(Node& first, Node& last) noexcept {
+      require_fit(std::addressof(first));
+      std::uint64_t head = m_head.load(std::memory_order_relaxed);
+      do {
+        link(last).store(address(head), std::memory_order_relaxed);
+      } while (!m_head.compare_exchange_weak(head, pack(std::addressof(first), head), std::memory_order_release,
+        std::memory_order_relaxed));
+    }
+
+
+    /// Pops and returns the node on top of the stack, or an empty reference if the stack is empty.
+    [[nodiscard]] optional_reference<Node> pop() noexcept {
+      std::uint64_t head = m_head.load(std::memory_order_acquire);
+      optional_reference<Node> top;
+      Node* next;
+      do {
+        top = address(head);
+        if (!top) return nullref;
+        next = link(*top).load(std::memory_order_relaxed).ptr();
+        require_fit(next);
+      } while (!m_head.compare_exchange_weak(head, pack(next, head), std::memory_order_acquire,
+        std::memory_order_acquire));
+      return top;
+    }
+
+    /// Takes every node off the stack in one step and returns the former top, whose Next chain reaches the rest.
+    [[nodiscard]] optional_reference<Node> pop_all() noexcept {
+      std::uint64_t head = m_head.load(std::memory_order_relaxed);
+      while (!m_head.compare_exchange_weak(head, pack(nullptr, head), std::memory_order_acquire,
+        std::memory_order_relaxed)) {}
+      return address(head);
+    }
+
+
+    /// Returns true if the stack holds no nodes. The answer may be out of date by the time it is used.
+    [[nodiscard]] bool empty() const noexcept {
+      return !address(m_head.load(std::memory_order_relaxed));
+    }
+
+  private:
+    static constexpr unsigned tag_shift = sizeof(void*) >= 8 ? 48 : 32;
+    static constexpr std::uint64_t address_mask = (std::uint64_t(1) << tag_shift) - 1;
+
+    static_assert(sizeof(void*) <= 8, "ref_stack packs a pointer and a tag into 64 bits");
+
+
+    [[nodiscard]] static bool fits(const Node* node) noexcept {
+      return (reinterpret_cast<std::uintptr_t>(node) & ~address_mask) == 0;
+    }
+
+    /// Prints a diagnostic and aborts unless node fits next to the tag.
+    static void require_fit(const Node* node) noexcept {
+      if (fits(node)) return;
+      std::fprintf(stderr, "ref_stack: node address %p does not fit next to the ABA tag\n",
+        static_cast<const volatile void*>(node));
+      std::abort();
+    }
+
+    [[nodiscard]] static Node* address(std::uint64_t word) noexcept {
+      return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(word & address_mask));
+    }
+
+    /// Packs node with the tag following the one of the previous head.
+    [[nodiscard]] static std::uint64_t pack(const Node* node, std::uint64_t previous) noexcept {
+      return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(node))
+        | (((previous >> tag_shift) + 1) << tag_shift);
+    }
+
+    /// The link may be rewritten by a pusher while a stale popper is reading it, so it is only accessed atomically.
+    [[nodiscard]] static std::atomic_ref<optional_reference<Node>> link(Node& node) noexcept {
+      static_assert(std::atomic_ref<optional_reference<Node>>::is_always_lock_free,
+        "ref_stack needs pointer-sized links, which DL_OPTIONAL_REFERENCE_TRACK_ORIGIN does not provide");
+      return std::atomic_ref<optional_reference<Node>>(node.*Next);
+    }
+
+
+    std::atomic<std::uint64_t> m_head;
+
+  }; // template class ref_stack
+
+
+  /// @brief Fixed-capacity lock-free pool of objects of type T.
+  /// @details All storage is allocated up front and the free slots are kept on a ref_stack, so make() and destroy()
+  /// are a single CAS each and may be called from any thread. Objects still alive when the pool is destroyed are not
+  /// destroyed.
+  template <class T>
+  class ref_pool {
+
+  public:
+    /// Constructs a pool with room for capacity objects.
+    [[nodiscard]] explicit ref_pool(std::size_t capacity)
+      : m_slots(std::make_unique<slot[]>(capacity)), m_capacity(capacity) {
+      if (capacity == 0) return;
+      for (std::size_t i = 0; i + 1 < capacity; ++i) m_slots[i].next = m_slots[i + 1];
+      m_free.push(m_slots[0], m_slots[capacity - 1]);
+    }
+
+    ref_pool(const ref_pool&) = delete;
+    ref_pool& operator=(const ref_pool&) = delete;
+
+
+    /// @brief Constructs an object from args in a free slot.
+    /// @return A reference to the new object, or an empty reference if the pool is exhausted.
+    template <class... Args>
+    [[nodiscard]] optional_reference<T> make(Args&&... args) {
+      optional_reference<slot> free = m_free.pop();
+      if (!free) return nullref;
+      if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+        return *::new (static_cast<void*>(free->storage)) T(std::forward<Args>(args)...);
+      } else {
+        try {
+          return *::new (static_cast<void*>(free->storage)) T(std::forward<Args>(args)...);
+        } catch (...) {
+          m_free.push(*free);
+          throw;
+        }
+      }
+    }
+
+    /// Destroys an object created by make() and returns its slot to the pool.
+    void destroy(T& object) noexcept {
+      slot* owner = reinterpret_cast<slot*>(std::addressof(object));
+      assert(owner >= m_slots.get() && owner < m_slots.get() + m_capacity && "object does not belong to this pool");
+      object.~T();
+      m_free.push(*owner);
+    }
+
+
+    /// Returns the number of objects the pool can hold.
+    [[nodiscard]] std::size_t capacity() const noexcept {
+      return m_capacity;
+    }
+
+  private:
+    // The storage comes first so that the address of an object is the address of its slot.
+    struct slot {
+      alignas(T) std::byte storage[sizeof(T)];
+      optional_reference<slot> next;
+    };
+
+
+    std::unique_ptr<slot[]> m_slots;
+    std::size_t m_capacity;
+    ref_stack<slot> m_free;
+
+  }; // template class ref_pool
+
+} // namespace dl
+
+#endif // !DL_REF_STACK_HPP
@@ -0,0 +1,125 @@
+
+/// @brief Sequence-lock protected optional_reference with a payload, for consistent reads without reader stores.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_SEQLOCK_REF_HPP
+#define DL_SEQLOCK_REF_HPP
+
+#include "optional_reference.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <variant>
+
+
+namespace dl {
+
+  /// @brief A reference to a T and a small trivially copyable Payload that one writer updates together and any
+  /// number of readers read consistently.
+  /// @details The writer makes the sequence counter odd, stores the reference and the payload, and makes it even
+  /// again. A reader copies everything between two reads of the counter and retries if the counter was odd or has
+  /// changed, so readers never write to the shared cache line and never block the writer. The payload is kept in
+  /// atomic words so that a read overlapping a write is a retry rather than a data race. Stores must not be made
+  /// from more than one thread at a time.
+  template <class T, class Payload = std::monostate>
+  class alignas(64) seqlock_ref {
+
+    static_assert(std::is_trivially_copyable_v<Payload>, "the payload is copied bytewise and must be trivially copyable");
+
+  public:
+    /// A consistent copy of the reference and the payload.
+    struct snapshot {
+      optional_reference<const T> target;
+      Payload payload;
+    };
+
+
+    /// Constructs an object holding an empty reference and a value-initialized payload.
+    [[nodiscard]] seqlock_ref() noexcept
+      : seqlock_ref(nullref, Payload()) {}
+
+    /// Constructs an object holding target and payload.
+    [[nodiscard]] seqlock_ref(optional_reference<const T> target, const Payload& payload) noexcept
+      : m_sequence(0), m_target(target.ptr()), m_words() {
+      write_payload(payload);
+    }
+
+    seqlock_ref(const seqlock_ref&) = delete;
+    seqlock_ref& operator=(const seqlock_ref&) = delete;
+
+
+    /// Replaces the reference and the payload. Must not be called concurrently with another store().
+    void store(optional_reference<const T> target, const Payload& payload) noexcept {
+      const std::uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+      m_sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      m_target.store(target.ptr(), std::memory_order_relaxed);
+      write_payload(payload);
+
+      m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /// Returns a consistent copy of the reference and the payload, retrying while a store is in progress.
+    [[nodiscard]] snapshot load() const noexcept {
+      std::uintptr_t words[word_count];
+      for (;;) {
+        const std::uint64_t before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        const T* target = m_target.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < word_count; ++i) words[i] = m_words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+          snapshot result{ target, Payload() };
+          std::memcpy(static_cast<void*>(std::addressof(result.payload)), words, sizeof(Payload));
+          return result;
+        }
+      }
+    }
+
+    /// Returns the number of completed stores.
+    [[nodiscard]] std::uint64_t version() const noexcept {
+      return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+
+  private:
+    static constexpr std::size_t word_count = (sizeof(Payload) + sizeof(std::uintptr_t) - 1) / sizeof(std::uintptr_t);
+
+
+    void write_payload(const Payload& payload) noexcept {
+      std::uintptr_t words[word_count] = {};
+      std::memcpy(words, std::addressof(payload), sizeof(Payload));
+      for (std::size_t i = 0; i < word_count; ++i) m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+
+    std::atomic<std::uint64_t> m_sequence;
+    std::atomic<const T*> m_target;
+    std::atomic<std::uintptr_t> m_words[word_count];
+
+  }; // template class seqlock_ref
+
+} // namespace dl
+
+#endif // !DL_SEQLOCK_REF_HPP
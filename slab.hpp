@@ -0,0 +1,275 @@
+
+/// @brief Chunked slab with stable addresses and O(1) id to optional_reference lookup.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_SLAB_HPP
+#define DL_SLAB_HPP
+
+#include "optional_reference.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace dl {
+
+  /// @brief Container of objects addressed by dense integer ids that never moves its elements.
+  /// @details Elements live in chunks of ChunkSize slots, each with an occupancy bitmap. An id is a chunk number and a
+  /// slot within it, so get() is two array lookups and a bit test, and iteration visits occupied slots by scanning the
+  /// bitmaps a word at a time. New elements go to chunks that are already allocated before any other is opened. A chunk
+  /// whose last element is erased is deallocated, except that one empty chunk is kept for reuse so that churn at a chunk
+  /// boundary does not allocate. Ids are reused: an id that outlives its element may later resolve to a newer one.
+  template <class T, std::size_t ChunkSize = 256>
+  class slab {
+
+    static_assert(ChunkSize > 0 && ChunkSize % 64 == 0, "ChunkSize must be a positive multiple of 64");
+
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using id_type = std::size_t;
+
+
+    /// Constructs an empty slab.
+    [[nodiscard]] slab() noexcept = default;
+
+    slab(const slab&) = delete;
+    slab& operator=(const slab&) = delete;
+
+    /// Takes the elements of other, leaving it empty.
+    [[nodiscard]] slab(slab&& other) noexcept
+      : m_chunks(std::move(other.m_chunks)), m_free(std::move(other.m_free)), m_released(std::move(other.m_released)),
+        m_spare(std::move(other.m_spare)), m_size(std::exchange(other.m_size, 0)) {
+      other.clear();
+    }
+
+    /// Destroys the elements of *this and takes those of other, leaving it empty.
+    slab& operator=(slab&& other) noexcept {
+      if (this != &other) {
+        m_chunks = std::move(other.m_chunks);
+        m_free = std::move(other.m_free);
+        m_released = std::move(other.m_released);
+        m_spare = std::move(other.m_spare);
+        m_size = std::exchange(other.m_size, 0);
+        other.clear();
+      }
+      return *this;
+    }
+
+
+    /// Constructs an element from args and returns its id.
+    template <class... Args>
+    id_type emplace(Args&&... args) {
+      if (m_free.empty()) open();
+
+      const std::size_t number = m_free.back();
+      chunk& owner = *m_chunks[number];
+      const std::size_t slot = owner.first_free();
+      ::new (static_cast<void*>(owner.at(slot))) T(std::forward<Args>(args)...);
+      owner.occupy(slot);
+      if (owner.count == ChunkSize) unlist(owner);
+      ++m_size;
+      return number * ChunkSize + slot;
+    }
+
+    /// Destroys the element with the given id. Returns false if there is no such element.
+    bool erase(id_type id) noexcept {
+      chunk* owner = find(id);
+      const std::size_t slot = id % ChunkSize;
+      if (!owner || !owner->occupied(slot)) return false;
+
+      if (owner->count == ChunkSize) list(id / ChunkSize);
+      owner->at(slot)->~T();
+      owner->vacate(slot);
+      if (owner->count == 0) release(id / ChunkSize);
+      --m_size;
+      return true;
+    }
+
+    /// Destroys every element and deallocates every chunk.
+    void clear() noexcept {
+      m_chunks.clear();
+      m_free.clear();
+      m_released.clear();
+      m_spare.reset();
+      m_size = 0;
+    }
+
+
+    /// Returns a reference to the element with the given id, or an empty reference if there is none.
+    [[nodiscard]] optional_reference<T> get(id_type id) noexcept {
+      chunk* owner = find(id);
+      return owner && owner->occupied(id % ChunkSize) ? optional_reference<T>(owner->at(id % ChunkSize)) : nullref;
+    }
+
+    /// Returns a reference to the element with the given id, or an empty reference if there is none.
+    [[nodiscard]] optional_reference<const T> get(id_type id) const noexcept {
+      return const_cast<slab&>(*this).get(id);
+    }
+
+
+    /// Calls f(id, element) for every element, in id order.
+    template <class F>
+    void for_each(F&& f) {
+      visit<T>(*this, f);
+    }
+
+    /// Calls f(id, element) for every element, in id order.
+    template <class F>
+    void for_each(F&& f) const {
+      visit<const T>(*this, f);
+    }
+
+
+    /// Returns the number of elements.
+    [[nodiscard]] size_type size() const noexcept {
+      return m_size;
+    }
+
+    /// Returns true if the slab has no elements.
+    [[nodiscard]] bool empty() const noexcept {
+      return m_size == 0;
+    }
+
+  private:
+    static constexpr std::size_t words = ChunkSize / 64;
+
+    struct chunk {
+      std::array<std::uint64_t, words> bitmap{};
+      std::size_t count = 0;
+      std::size_t free_index = 0;   // Position in m_free while the chunk has free slots.
+      alignas(T) std::byte storage[sizeof(T) * ChunkSize];
+
+      chunk() noexcept = default;
+      chunk(const chunk&) = delete;
+      chunk& operator=(const chunk&) = delete;
+
+      ~chunk() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+          for (std::size_t w = 0; w < words; ++w) {
+            for (std::uint64_t bits = bitmap[w]; bits; bits &= bits - 1) at(w * 64 + std::countr_zero(bits))->~T();
+          }
+        }
+      }
+
+      [[nodiscard]] T* at(std::size_t slot) noexcept {
+        return std::launder(reinterpret_cast<T*>(storage + slot * sizeof(T)));
+      }
+
+      [[nodiscard]] bool occupied(std::size_t slot) const noexcept {
+        return (bitmap[slot / 64] >> (slot % 64)) & 1;
+      }
+
+      [[nodiscard]] std::size_t first_free() const noexcept {
+        std::size_t w = 0;
+        while (bitmap[w] == ~std::uint64_t(0)) ++w;
+        return w * 64 + std::countr_one(bitmap[w]);
+      }
+
+      void occupy(std::size_t slot) noexcept {
+        bitmap[slot / 64] |= std::uint64_t(1) << (slot % 64);
+        ++count;
+      }
+
+      void vacate(std::size_t slot) noexcept {
+        bitmap[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+        --count;
+      }
+    };
+
+
+    /// Allocates a chunk, or takes the spare one, under a deallocated chunk number if there is one.
+    void open() {
+      std::unique_ptr<chunk> fresh = m_spare ? std::move(m_spare) : std::make_unique<chunk>();
+      std::size_t number;
+      if (m_released.empty()) {
+        m_chunks.emplace_back();
+        number = m_chunks.size() - 1;
+        // Neither list can outgrow the chunk table, so reserving here keeps list() and release() from throwing.
+        m_free.reserve(m_chunks.capacity());
+        m_released.reserve(m_chunks.capacity());
+      } else {
+        number = m_released.back();
+        m_released.pop_back();
+      }
+      m_chunks[number] = std::move(fresh);
+      list(number);
+    }
+
+    void list(std::size_t number) noexcept {
+      m_chunks[number]->free_index = m_free.size();
+      m_free.push_back(number);
+    }
+
+    void unlist(chunk& owner) noexcept {
+      const std::size_t last = m_free.back();
+      m_free[owner.free_index] = last;
+      m_chunks[last]->free_index = owner.free_index;
+      m_free.pop_back();
+    }
+
+    /// Deallocates an empty chunk, or keeps it as the spare if there is none.
+    void release(std::size_t number) noexcept {
+      unlist(*m_chunks[number]);
+      if (!m_spare) {
+        m_spare = std::move(m_chunks[number]);
+      } else {
+        m_chunks[number].reset();
+      }
+      m_released.push_back(number);
+    }
+
+    [[nodiscard]] chunk* find(id_type id) const noexcept {
+      const std::size_t number = id / ChunkSize;
+      return number < m_chunks.size() ? m_chunks[number].get() : nullptr;
+    }
+
+    template <class U, class Self, class F>
+    static void visit(Self& self, F& f) {
+      for (std::size_t number = 0; number < self.m_chunks.size(); ++number) {
+        chunk* owner = self.m_chunks[number].get();
+        if (!owner) continue;
+        for (std::size_t w = 0; w < words; ++w) {
+          for (std::uint64_t bits = owner->bitmap[w]; bits; bits &= bits - 1) {
+            const std::size_t slot = w * 64 + std::countr_zero(bits);
+            f(static_cast<id_type>(number * ChunkSize + slot), static_cast<U&>(*owner->at(slot)));
+          }
+        }
+      }
+    }
+
+
+    std::vector<std::unique_ptr<chunk>> m_chunks;
+    std::vector<std::size_t> m_free;       // Allocated chunks with at least one free slot.
+    std::vector<std::size_t> m_released;   // Chunk numbers whose chunk has been deallocated.
+    std::unique_ptr<chunk> m_spare;
+    size_type m_size = 0;
+
+  }; // template class slab
+
+} // namespace dl
+
+#endif // !DL_SLAB_HPP
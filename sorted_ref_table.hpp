@@ -0,0 +1,151 @@
+
+/// @brief Build-once sorted lookup table with an optional_reference based lookup API.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_SORTED_REF_TABLE_HPP
+#define DL_SORTED_REF_TABLE_HPP
+
+#include "optional_reference.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+
+namespace dl {
+
+  /// @brief Immutable key-value table stored in Eytzinger (breadth-first binary tree) order.
+  /// @details The table is built once from an unsorted range and cannot be modified afterwards. Lookups descend the
+  /// implicit tree without branching on the comparison result and prefetch the cache line holding the node four
+  /// levels down, which keeps the search latency close to that of a handful of dependent loads.
+  /// If the input contains duplicate keys, the first occurrence is kept.
+  template <class Key, class T, class Compare = std::less<Key>>
+  class sorted_ref_table {
+
+  public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using key_compare = Compare;
+
+
+    /// Constructs an empty table.
+    sorted_ref_table() = default;
+
+    /// Builds the table from a range of key-value pairs.
+    template <class InputIt>
+    sorted_ref_table(InputIt first, InputIt last, const Compare& compare = Compare())
+      : m_compare(compare) {
+      build(std::vector<value_type>(first, last));
+    }
+
+    /// Builds the table from a list of key-value pairs.
+    sorted_ref_table(std::initializer_list<value_type> values, const Compare& compare = Compare())
+      : sorted_ref_table(values.begin(), values.end(), compare) {}
+
+    /// Builds the table by taking ownership of a vector of key-value pairs.
+    explicit sorted_ref_table(std::vector<value_type>&& values, const Compare& compare = Compare())
+      : m_compare(compare) {
+      build(std::move(values));
+    }
+
+
+    /// Returns a reference to the value mapped to key, or an empty reference if there is no such element.
+    [[nodiscard]] optional_reference<const T> find(const Key& key) const noexcept {
+      const std::size_t index = lower_bound_index(key);
+      if (index == 0 || m_compare(key, m_keys[index - 1])) return nullref;
+      return m_values[index - 1];
+    }
+
+    /// Returns true if the table contains an element with the given key.
+    [[nodiscard]] bool contains(const Key& key) const noexcept {
+      return find(key).has_ref();
+    }
+
+
+    /// Returns the number of elements.
+    [[nodiscard]] size_type size() const noexcept {
+      return m_keys.size();
+    }
+
+    /// Returns true if the table contains no elements.
+    [[nodiscard]] bool empty() const noexcept {
+      return m_keys.empty();
+    }
+
+  private:
+    /// Returns the one-based tree index of the first key not less than key, or 0 if there is none.
+    std::size_t lower_bound_index(const Key& key) const noexcept {
+      const Key* const keys = m_keys.data();
+      const std::size_t n = m_keys.size();
+      std::size_t k = 1;
+      while (k <= n) {
+#if defined(__GNUC__) || defined(__clang__)
+        // Node 16k lies four levels below k; its siblings share the same cache line for small keys.
+        __builtin_prefetch(keys + (std::min(k * 16, n) - 1));
+#endif
+        k = 2 * k + static_cast<std::size_t>(m_compare(keys[k - 1], key));
+      }
+      // Undo the trailing right turns made after the last left turn, which was at the answer.
+      return k >> (std::countr_one(k) + 1);
+    }
+
+    void build(std::vector<value_type>&& values) {
+      std::stable_sort(values.begin(), values.end(), [this](const value_type& a, const value_type& b) {
+        return m_compare(a.first, b.first);
+      });
+      values.erase(std::unique(values.begin(), values.end(), [this](const value_type& a, const value_type& b) {
+        return !m_compare(a.first, b.first) && !m_compare(b.first, a.first);
+      }), values.end());
+
+      // The in-order traversal of the implicit tree visits the nodes in sorted order.
+      std::vector<std::size_t> order(values.size());
+      std::size_t next = 0;
+      assign_in_order(order, 1, next);
+
+      m_keys.reserve(values.size());
+      m_values.reserve(values.size());
+      for (std::size_t sorted : order) {
+        m_keys.push_back(std::move(values[sorted].first));
+        m_values.push_back(std::move(values[sorted].second));
+      }
+    }
+
+    static void assign_in_order(std::vector<std::size_t>& order, std::size_t k, std::size_t& next) {
+      if (k > order.size()) return;
+      assign_in_order(order, 2 * k, next);
+      order[k - 1] = next++;
+      assign_in_order(order, 2 * k + 1, next);
+    }
+
+
+    [[no_unique_address]] Compare m_compare;
+    std::vector<Key> m_keys;
+    std::vector<T> m_values;
+
+  }; // template class sorted_ref_table
+
+} // namespace dl
+
+#endif // !DL_SORTED_REF_TABLE_HPP
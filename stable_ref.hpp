@@ -0,0 +1,115 @@
+
+/// @brief Reallocation-safe reference into a random-access container, stored as a container and an index.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_STABLE_REF_HPP
+#define DL_STABLE_REF_HPP
+
+#include "optional_reference.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  /// @brief Reference to an element of a std::vector-like container that survives reallocation.
+  /// @details Stores the address of the container and the element's index instead of the element's address, and
+  /// resolves them on every get(). The element stays contiguous with its neighbours while the reference stays valid
+  /// across push_back and reserve; it becomes empty if the container shrinks below the index. Insertions and erasures
+  /// before the index shift which element is referenced, just as they shift indices. The container must outlive
+  /// every stable_ref into it.
+  template <class Vec>
+  class stable_ref {
+
+    static_assert(std::is_lvalue_reference_v<decltype(std::declval<Vec&>()[std::size_t()])>,
+      "stable_ref requires a container whose operator[] returns a reference");
+
+  public:
+    using container_type = Vec;
+    using element_type = std::remove_reference_t<decltype(std::declval<Vec&>()[std::size_t()])>;
+    using size_type = std::size_t;
+
+
+    /// Constructs an object that does not refer to any container.
+    [[nodiscard]] constexpr stable_ref() noexcept
+      : m_container(nullptr), m_index(0) {}
+
+    /// Constructs an object that does not refer to any container.
+    [[nodiscard]] constexpr stable_ref(nullref_t) noexcept
+      : m_container(nullptr), m_index(0) {}
+
+    /// Constructs an object referring to the element at index in container.
+    [[nodiscard]] constexpr stable_ref(Vec& container, size_type index) noexcept
+      : m_container(std::addressof(container)), m_index(index) {}
+
+    /// Const conversion.
+    template <class U, std::enable_if_t<std::is_same_v<const U, Vec> && !std::is_same_v<U, Vec>, int> = 0>
+    [[nodiscard]] constexpr stable_ref(const stable_ref<U>& other) noexcept
+      : m_container(other.container().ptr()), m_index(other.index()) {}
+
+
+    /// Returns a reference to the element, or an empty reference if there is no container or the index is out of range.
+    [[nodiscard]] constexpr optional_reference<element_type> get() const noexcept(noexcept(m_container->size())) {
+      if (!m_container || m_index >= m_container->size()) return nullref;
+      return (*m_container)[m_index];
+    }
+
+    /// Returns the referenced container, or an empty reference if there is none.
+    [[nodiscard]] constexpr optional_reference<Vec> container() const noexcept {
+      return m_container;
+    }
+
+    /// Returns the index of the referenced element.
+    [[nodiscard]] constexpr size_type index() const noexcept {
+      return m_index;
+    }
+
+
+    /// Makes *this refer to no container.
+    constexpr void reset() noexcept {
+      m_container = nullptr;
+      m_index = 0;
+    }
+
+
+    /// Returns true if both objects refer to the same index of the same container, or both refer to none.
+    [[nodiscard]] friend constexpr bool operator==(const stable_ref& lhs, const stable_ref& rhs) noexcept {
+      return lhs.m_container == rhs.m_container && lhs.m_index == rhs.m_index;
+    }
+
+    [[nodiscard]] friend constexpr bool operator!=(const stable_ref& lhs, const stable_ref& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+
+  private:
+    Vec* m_container;
+    size_type m_index;
+
+  }; // template class stable_ref
+
+
+  template <class Vec>
+  stable_ref(Vec&, std::size_t) -> stable_ref<Vec>;
+
+} // namespace dl
+
+#endif // !DL_STABLE_REF_HPP
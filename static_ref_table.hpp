@@ -0,0 +1,209 @@
+
+/// @brief Compile-time perfect hash table with an optional_reference based lookup API.
+///
+/// @section License
+/// Copyright (c) 2022 Dario Cvitanović
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+/// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+/// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all copies or
+/// substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+/// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+/// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+/// OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DL_STATIC_REF_TABLE_HPP
+#define DL_STATIC_REF_TABLE_HPP
+
+#include "hash_mix.hpp"
+#include "optional_reference.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+namespace dl {
+
+  /// @brief Default constexpr hash used by static_ref_table.
+  /// @details Specializations must provide a constexpr operator() returning a 64-bit hash of the key.
+  template <class Key, class = void>
+  struct static_hash;
+
+  /// Hash for integral and enumeration keys.
+  template <class Key>
+  struct static_hash<Key, std::enable_if_t<std::is_integral_v<Key> || std::is_enum_v<Key>>> {
+    [[nodiscard]] constexpr std::uint64_t operator()(Key key) const noexcept {
+      return static_cast<std::uint64_t>(key);
+    }
+  };
+
+  /// FNV-1a hash for keys convertible to std::string_view.
+  template <class Key>
+  struct static_hash<Key, std::enable_if_t<std::is_convertible_v<const Key&, std::string_view>>> {
+    [[nodiscard]] constexpr std::uint64_t operator()(std::string_view key) const noexcept {
+      std::uint64_t hash = 0xCBF29CE484222325;
+      for (char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001B3;
+      }
+      return hash;
+    }
+  };
+
+
+  /// @brief Immutable hash table laid out entirely at compile time.
+  /// @details Keys are distributed over buckets, and each bucket stores the seed that sends all of its keys to
+  /// distinct slots (hash and displace). A lookup therefore hashes once, reads one seed and one slot, and compares
+  /// one key, without any probing. Declaring the table constexpr places it in read-only data, so using it costs no
+  /// static initialization.
+  template <class Key, class T, std::size_t N, class Hash = static_hash<Key>>
+  class static_ref_table {
+
+  public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+
+
+    /// @brief Builds the table from a list of key-value pairs.
+    /// @exception std::invalid_argument - If entries contains a duplicate key. In a constant expression this
+    /// surfaces as a compilation error.
+    constexpr explicit static_ref_table(const std::array<value_type, N>& entries)
+      : m_entries(entries), m_seeds(), m_slots(), m_hash() {
+      build();
+    }
+
+
+    /// Returns a reference to the value mapped to key, or an empty reference if there is no such element.
+    [[nodiscard]] constexpr optional_reference<const T> find(const Key& key) const noexcept {
+      const std::uint64_t hash = m_hash(key);
+      const std::uint32_t index = m_slots[slot_of(hash, m_seeds[bucket_of(hash)])];
+      if (index == empty_slot || !(m_entries[index].first == key)) return nullref;
+      return m_entries[index].second;
+    }
+
+    /// Returns true if the table contains an element with the given key.
+    [[nodiscard]] constexpr bool contains(const Key& key) const noexcept {
+      return find(key).has_ref();
+    }
+
+
+    /// Returns the number of elements.
+    [[nodiscard]] constexpr size_type size() const noexcept {
+      return N;
+    }
+
+    /// Returns the entries in the order they were passed to the constructor.
+    [[nodiscard]] constexpr const std::array<value_type, N>& entries() const noexcept {
+      return m_entries;
+    }
+
+  private:
+    static constexpr std::size_t bucket_count = N == 0 ? 1 : N;
+    static constexpr std::size_t slot_count = std::bit_ceil(bucket_count);
+    static constexpr std::uint32_t empty_slot = static_cast<std::uint32_t>(-1);
+    static constexpr std::uint32_t max_seed = 1u << 24;
+
+    static_assert(N < empty_slot, "static_ref_table is limited to 2^32 - 1 entries");
+
+
+    static constexpr std::size_t bucket_of(std::uint64_t hash) noexcept {
+      return static_cast<std::size_t>((detail::mix(hash) >> 32) * bucket_count >> 32);
+    }
+
+    static constexpr std::size_t slot_of(std::uint64_t hash, std::uint32_t seed) noexcept {
+      return static_cast<std::size_t>(detail::mix(hash ^ (seed * 0x9E3779B97F4A7C15)) & (slot_count - 1));
+    }
+
+    constexpr void build() {
+      for (std::uint32_t& slot : m_slots) slot = empty_slot;
+
+      std::array<std::uint64_t, N> hashes{};
+      std::array<std::size_t, bucket_count + 1> starts{};
+      for (std::size_t i = 0; i < N; ++i) {
+        hashes[i] = m_hash(m_entries[i].first);
+        ++starts[bucket_of(hashes[i]) + 1];
+      }
+
+      // Groups the entry indices by bucket, so that bucket b owns members[starts[b], starts[b + 1]).
+      std::size_t largest = 0;
+      for (std::size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        if (starts[bucket + 1] > largest) largest = starts[bucket + 1];
+        starts[bucket + 1] += starts[bucket];
+      }
+      std::array<std::size_t, N> members{};
+      std::array<std::size_t, bucket_count> filled{};
+      for (std::size_t i = 0; i < N; ++i) {
+        const std::size_t bucket = bucket_of(hashes[i]);
+        members[starts[bucket] + filled[bucket]++] = i;
+      }
+
+      // Placing the most crowded buckets first, while the table is still empty, keeps the seed search short.
+      for (std::size_t size = largest; size > 0; --size) {
+        for (std::size_t bucket = 0; bucket < bucket_count; ++bucket) {
+          if (starts[bucket + 1] - starts[bucket] != size) continue;
+
+          m_seeds[bucket] = find_seed(hashes, members, starts[bucket], size);
+          for (std::size_t i = starts[bucket]; i < starts[bucket + 1]; ++i) {
+            m_slots[slot_of(hashes[members[i]], m_seeds[bucket])] = static_cast<std::uint32_t>(members[i]);
+          }
+        }
+      }
+    }
+
+    /// Returns the first seed that sends every member of a bucket to a distinct empty slot.
+    constexpr std::uint32_t find_seed(const std::array<std::uint64_t, N>& hashes,
+      const std::array<std::size_t, N>& members, std::size_t first, std::size_t count) const {
+      for (std::uint32_t seed = 0; seed < max_seed; ++seed) {
+        bool fits = true;
+        for (std::size_t i = first; i < first + count && fits; ++i) {
+          const std::size_t slot = slot_of(hashes[members[i]], seed);
+          fits = m_slots[slot] == empty_slot;
+          for (std::size_t j = first; j < i && fits; ++j) {
+            if (hashes[members[j]] == hashes[members[i]] && m_entries[members[j]].first == m_entries[members[i]].first) {
+              throw std::invalid_argument("static_ref_table: duplicate key");
+            }
+            fits = slot_of(hashes[members[j]], seed) != slot;
+          }
+        }
+        if (fits) return seed;
+      }
+      throw std::invalid_argument("static_ref_table: no perfect hash found (keys with colliding hashes?)");
+    }
+
+
+    std::array<value_type, N> m_entries;
+    std::array<std::uint32_t, bucket_count> m_seeds;
+    std::array<std::uint32_t, slot_count> m_slots;
+    [[no_unique_address]] Hash m_hash;
+
+  }; // template class static_ref_table
+
+
+  /// @brief Returns a static_ref_table holding the passed entries.
+  /// @details Intended for initializing constexpr variables, for example
+  /// `constexpr auto keywords = dl::make_static_ref_table<std::string_view, token>({{"if", token::if_}, ...});`.
+  template <class Key, class T, class Hash = static_hash<Key>, std::size_t N>
+  [[nodiscard]] constexpr static_ref_table<Key, T, N, Hash> make_static_ref_table(
+    const std::pair<Key, T> (&entries)[N]) {
+    std::array<std::pair<Key, T>, N> array{};
+    for (std::size_t i = 0; i < N; ++i) array[i] = entries[i];
+    return static_ref_table<Key, T, N, Hash>(array);
+  }
+
+} // namespace dl
+
+#endif // !DL_STATIC_REF_TABLE_HPP